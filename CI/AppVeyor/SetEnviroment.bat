@@ -4,6 +4,7 @@ if "%1" == "" goto :finalize
 if /i "%1" == "x86" goto :x86
 if /i "%1" == "x64" goto :x64
 if /i "%1" == "msvc15" goto :msvc15
+if /i "%1" == "msvc16" goto :msvc16
 
 echo Invalid argument: '%1'
 exit -1
@@ -15,16 +16,18 @@ exit -1
 :x86
 set TARGET_CPU=x86
 set CMAKE_GENERATOR_SUFFIX=
-set BOOST_ROOT=C:\Libraries\boost_1_64_0
-set BOOST_LIBRARYDIR=C:\Libraries\boost_1_64_0\lib32-msvc-14.1
+set CMAKE_GENERATOR_ARCH=Win32
+set BOOST_ROOT=C:\Libraries\boost_%BOOST_VERSION%
+set BOOST_LIBRARYDIR=C:\Libraries\boost_%BOOST_VERSION%\lib32-%BOOST_TOOLSET%
 shift
 goto :loop
 
 :x64
 set TARGET_CPU=x64
 set CMAKE_GENERATOR_SUFFIX= Win64
-set BOOST_ROOT=C:\Libraries\boost_1_64_0
-set BOOST_LIBRARYDIR=C:\Libraries\boost_1_64_0\lib64-msvc-14.1
+set CMAKE_GENERATOR_ARCH=x64
+set BOOST_ROOT=C:\Libraries\boost_%BOOST_VERSION%
+set BOOST_LIBRARYDIR=C:\Libraries\boost_%BOOST_VERSION%\lib64-%BOOST_TOOLSET%
 shift
 goto :loop
 
@@ -35,6 +38,18 @@ goto :loop
 :msvc15
 set TOOLCHAIN=msvc15
 set CMAKE_GENERATOR=Visual Studio 15 2017
+set BOOST_VERSION=1_66_0
+set BOOST_TOOLSET=msvc-14.1
+shift
+goto :loop
+
+:: Visual Studio 2019 (16.8+) compiles coroutines with /std:c++latest, so coroutine tests are built by it
+
+:msvc16
+set TOOLCHAIN=msvc16
+set CMAKE_GENERATOR=Visual Studio 16 2019
+set BOOST_VERSION=1_77_0
+set BOOST_TOOLSET=msvc-14.2
 shift
 goto :loop
 
@@ -48,7 +63,11 @@ if "%TOOLCHAIN%" == "" goto :msvc15
 if "%TARGET_CPU%" == "" goto :x86
 if "%CONFIGURATION%" == "" (set CONFIGURATION=Release)
 
-set CMAKE_CONFIGURE_FLAGS=-G "%CMAKE_GENERATOR%%CMAKE_GENERATOR_SUFFIX%" -DBoost_INCLUDE_DIRS="%BOOST_ROOT%" -DBoost_LIBRARY_DIRS="%BOOST_LIBRARYDIR%" -DBUILD_SHARED_LIBS=ON
+set CMAKE_GENERATOR_FLAGS=-G "%CMAKE_GENERATOR%%CMAKE_GENERATOR_SUFFIX%"
+:: Since Visual Studio 2019 platform is not a part of generator name
+if "%TOOLCHAIN%" == "msvc16" (set CMAKE_GENERATOR_FLAGS=-G "%CMAKE_GENERATOR%" -A %CMAKE_GENERATOR_ARCH%)
+
+set CMAKE_CONFIGURE_FLAGS=%CMAKE_GENERATOR_FLAGS% -DBoost_INCLUDE_DIRS="%BOOST_ROOT%" -DBoost_LIBRARY_DIRS="%BOOST_LIBRARYDIR%" -DBUILD_SHARED_LIBS=ON
 set CMAKE_BUILD_FLAGS= ^
 	--config %CONFIGURATION% ^
 	-- ^
@@ -5,7 +5,7 @@ echo Run build...
 mkdir -p build
 cd build
 BuildDir=$PWD
-cmake .. -DTARGET_CPU=$TARGET_CPU -DCMAKE_BUILD_TYPE=$BUILD_CONFIGURATION -DENABLE_COVERAGE=$COVERAGE
+cmake .. -DTARGET_CPU=$TARGET_CPU -DCMAKE_BUILD_TYPE=$BUILD_CONFIGURATION -DENABLE_COVERAGE=$COVERAGE -DTHREAD_POOL_CXX20_TESTS=${CXX20_TESTS:-Off}
 make
 echo Run tests...
 ctest -C $BUILD_CONFIGURATION --output-on-failure
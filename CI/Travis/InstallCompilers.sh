@@ -1,13 +1,17 @@
 #!/bin/sh
 
-# Install gcc-7
+# Install gcc-7 (gcc-10 for C++20 build, coroutines are supported since it)
 # sudo add-apt-repository -y ppa:ubuntu-toolchain-r/test
-echo Install GCC-7...
+GCC_VERSION=7
+if [ "$CXX20_TESTS" == "On" ]; then
+  GCC_VERSION=10
+fi
+echo Install GCC-$GCC_VERSION...
 sudo apt-get update -qq
-sudo apt-get install -qq g++-7
-sudo update-alternatives --install /usr/bin/g++ g++ /usr/bin/g++-7 90
+sudo apt-get install -qq g++-$GCC_VERSION
+sudo update-alternatives --install /usr/bin/g++ g++ /usr/bin/g++-$GCC_VERSION 90
 if [ $CXX == "g++" ]; then 
-  export CXX="g++-7"; 
+  export CXX="g++-$GCC_VERSION"; 
 fi
   
 # Install clang
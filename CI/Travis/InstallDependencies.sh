@@ -1,10 +1,12 @@
 #!/bin/sh
 
-# Install boost 1.64.0
-echo Install Boost 1.64.0...
-sudo wget -O boost_1_64_0.tar.gz http://sourceforge.net/projects/boost/files/boost/1.64.0/boost_1_64_0.tar.gz/download
-sudo tar xzf boost_1_64_0.tar.gz
-cd boost_1_64_0/
+# Install boost (1.66.0 if BOOST_VERSION is not set, C++20 build needs newer one)
+BOOST_VERSION=${BOOST_VERSION:-1.66.0}
+BOOST_DIR=boost_${BOOST_VERSION//./_}
+echo Install Boost $BOOST_VERSION...
+sudo wget -O $BOOST_DIR.tar.gz http://sourceforge.net/projects/boost/files/boost/$BOOST_VERSION/$BOOST_DIR.tar.gz/download
+sudo tar xzf $BOOST_DIR.tar.gz
+cd $BOOST_DIR/
 sudo ./bootstrap.sh --with-libraries=system,filesystem
 sudo ./b2 toolset=gcc link=shared threading=multi variant=$BUILD_CONFIGURATION
 sudo ./b2 install
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchmarkOptions
+{
+    size_t warmupRunCount{ 1 };
+    // Iterations of a run are doubled until the run takes at least this time, so short tests are measured above clock resolution.
+    std::chrono::nanoseconds minRunTime{ std::chrono::milliseconds{ 1 } };
+    // Median slower than baseline by more than this fraction is a regression.
+    double regressionThreshold{ 0.1 };
+};
+
+/** Statistics of benchmark runs, times are per iteration in ns.
+* Median and percentiles are computed over all runs, mean and stddev exclude outliers (out of Tukey fences: 1.5 IQR).
+*/
+struct BenchmarkResult
+{
+    std::string name;
+    std::string description;
+    size_t iterationCount{ 1 }; // Iterations per run
+    std::vector<double> runs;   // Sorted
+    double median{ 0 };
+    double p90{ 0 };
+    double p99{ 0 };
+    double mean{ 0 };
+    double stddev{ 0 };
+    size_t outlierCount{ 0 };
+
+    std::string GetKey() const
+    {
+        return name + (description.empty() ? "" : " | " + description);
+    }
+};
+
+/** The Benchmark class runs performance tests and reports statistics of their runs:
+* - every test is warmed up, then its run is scaled (iterations per run) to be at least minRunTime;
+* - results are printed, and optionally written as JSON (--benchmark-json file) and CSV (--benchmark-csv file);
+* - with --benchmark-baseline file (JSON of a previous run) medians are compared with the baseline
+*   and regressions are flagged (--benchmark-threshold percents, 10 by default).
+*/
+class Benchmark
+{
+public:
+    static Benchmark& Get()
+    {
+        static Benchmark benchmark;
+        return benchmark;
+    }
+
+    BenchmarkOptions& GetOptions()
+    {
+        return m_options;
+    }
+
+    // Unknown arguments are ignored (they belong to the test program).
+    void ParseArguments(int argc, char* argv[])
+    {
+        for (int index = 1; index + 1 < argc; ++index)
+        {
+            const std::string name{ argv[index] };
+            const std::string value{ argv[index + 1] };
+            if (name == "--benchmark-json")
+                m_jsonPath = value;
+            else if (name == "--benchmark-csv")
+                m_csvPath = value;
+            else if (name == "--benchmark-baseline")
+                m_baseline = ReadJson(value);
+            else if (name == "--benchmark-threshold")
+                m_options.regressionThreshold = std::atof(value.c_str())/100;
+            else
+                continue;
+            ++index;
+        }
+    }
+
+    template <typename TestT>
+    const BenchmarkResult& Run(const std::string& name, const std::string& description, size_t runCount, TestT&& test)
+    {
+        using ClockType = std::chrono::steady_clock;
+
+        std::cout << " - Benchmark test ( " << name;
+        if (!description.empty())
+            std::cout << ", description: " << description;
+        std::cout << std::flush;
+
+        const auto measure = [&test](size_t iterationCount) {
+            const auto start = ClockType::now();
+            for (size_t iteration = 0; iteration != iterationCount; ++iteration)
+                test();
+            return std::chrono::duration<double, std::nano>(ClockType::now() - start).count();
+        };
+
+        BenchmarkResult result;
+        result.name = name;
+        result.description = description;
+
+        auto warmupTime = 0.0;
+        for (size_t run = 0; run != m_options.warmupRunCount; ++run)
+            warmupTime = measure(1);
+
+        const auto minRunTime = static_cast<double>(m_options.minRunTime.count());
+        while (warmupTime*static_cast<double>(result.iterationCount) < minRunTime && result.iterationCount < (size_t{ 1 } << 30))
+        {
+            result.iterationCount *= 2;
+            if (warmupTime == 0)
+                warmupTime = measure(result.iterationCount)/static_cast<double>(result.iterationCount);
+        }
+
+        for (size_t run = 0; run != std::max<size_t>(runCount, 1); ++run)
+            result.runs.push_back(measure(result.iterationCount)/static_cast<double>(result.iterationCount));
+
+        ComputeStatistics(result);
+        m_results.push_back(std::move(result));
+
+        Print(m_results.back());
+        return m_results.back();
+    }
+
+    // Writes reports and compares results with the baseline. Returns number of regressions.
+    size_t Finish()
+    {
+        if (!m_jsonPath.empty())
+        {
+            std::ofstream file{ m_jsonPath };
+            WriteJson(file);
+        }
+        if (!m_csvPath.empty())
+        {
+            std::ofstream file{ m_csvPath };
+            WriteCsv(file);
+        }
+
+        size_t regressionCount = 0;
+        for (const auto& result : m_results)
+        {
+            if (GetChange(result) > m_options.regressionThreshold)
+                ++regressionCount;
+        }
+        if (!m_baseline.empty())
+            std::cout << "Benchmark regressions against baseline: " << regressionCount << std::endl;
+        return regressionCount;
+    }
+
+    // One benchmark per line, so the file is easy to diff and to read back as baseline.
+    void WriteJson(std::ostream& stream) const
+    {
+        stream << "{\"benchmarks\":[\n";
+        for (size_t index = 0; index != m_results.size(); ++index)
+        {
+            const auto& result = m_results[index];
+            stream << "{\"name\":\"" << Escape(result.name) << "\",\"description\":\"" << Escape(result.description)
+                << "\",\"unit\":\"ns\",\"runs\":" << result.runs.size() << ",\"iterations\":" << result.iterationCount
+                << std::fixed << std::setprecision(1)
+                << ",\"median\":" << result.median << ",\"p90\":" << result.p90 << ",\"p99\":" << result.p99
+                << ",\"mean\":" << result.mean << ",\"stddev\":" << result.stddev
+                << ",\"min\":" << result.runs.front() << ",\"max\":" << result.runs.back()
+                << ",\"outliers\":" << result.outlierCount << "}" << (index + 1 != m_results.size() ? ",\n" : "\n");
+        }
+        stream << "]}\n";
+    }
+
+    void WriteCsv(std::ostream& stream) const
+    {
+        stream << "name,description,runs,iterations,median_ns,p90_ns,p99_ns,mean_ns,stddev_ns,min_ns,max_ns,outliers\n";
+        for (const auto& result : m_results)
+        {
+            stream << '"' << result.name << "\",\"" << result.description << "\"," << result.runs.size() << ',' << result.iterationCount
+                << std::fixed << std::setprecision(1)
+                << ',' << result.median << ',' << result.p90 << ',' << result.p99 << ',' << result.mean << ',' << result.stddev
+                << ',' << result.runs.front() << ',' << result.runs.back() << ',' << result.outlierCount << '\n';
+        }
+    }
+
+    const std::vector<BenchmarkResult>& GetResults() const
+    {
+        return m_results;
+    }
+
+    static void ComputeStatistics(BenchmarkResult& result)
+    {
+        auto& runs = result.runs;
+        std::sort(runs.begin(), runs.end());
+
+        // Nearest rank.
+        const auto percentile = [&runs](double fraction) {
+            const auto rank = static_cast<size_t>(std::ceil(fraction*static_cast<double>(runs.size())));
+            return runs[std::min(runs.size(), std::max<size_t>(rank, 1)) - 1];
+        };
+
+        result.median = runs.size() % 2 != 0 ? runs[runs.size()/2] : (runs[runs.size()/2 - 1] + runs[runs.size()/2])/2;
+        result.p90 = percentile(0.9);
+        result.p99 = percentile(0.99);
+
+        const auto q1 = percentile(0.25);
+        const auto q3 = percentile(0.75);
+        const auto lowFence = q1 - 1.5*(q3 - q1);
+        const auto highFence = q3 + 1.5*(q3 - q1);
+
+        double sum = 0;
+        size_t count = 0;
+        for (const auto run : runs)
+        {
+            if (run >= lowFence && run <= highFence)
+            {
+                sum += run;
+                ++count;
+            }
+        }
+        result.outlierCount = runs.size() - count;
+        result.mean = sum/static_cast<double>(count);
+
+        double squareSum = 0;
+        for (const auto run : runs)
+        {
+            if (run >= lowFence && run <= highFence)
+                squareSum += (run - result.mean)*(run - result.mean);
+        }
+        result.stddev = count > 1 ? std::sqrt(squareSum/static_cast<double>(count - 1)) : 0;
+    }
+
+    // Time in ns with the most suitable unit, e.g. "1.500 us".
+    static std::string FormatTime(double ns)
+    {
+        static const std::pair<double, const char*> units[] = { { 1e9, "s" }, { 1e6, "ms" }, { 1e3, "us" } };
+
+        std::ostringstream stream;
+        stream << std::fixed << std::setprecision(3);
+        for (const auto& [scale, unit] : units)
+        {
+            if (ns >= scale)
+            {
+                stream << ns/scale << ' ' << unit;
+                return stream.str();
+            }
+        }
+        stream << ns << " ns";
+        return stream.str();
+    }
+
+private:
+    Benchmark() = default;
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    // Relative change of median against baseline (0 if there is no baseline for the result).
+    double GetChange(const BenchmarkResult& result) const
+    {
+        const auto baseline = m_baseline.find(result.GetKey());
+        if (baseline == m_baseline.end() || baseline->second <= 0)
+            return 0;
+        return result.median/baseline->second - 1;
+    }
+
+    void Print(const BenchmarkResult& result) const
+    {
+        std::cout << " ) => median " << FormatTime(result.median) << ", mean " << FormatTime(result.mean)
+            << " +- " << FormatTime(result.stddev) << ", p90 " << FormatTime(result.p90) << ", p99 " << FormatTime(result.p99)
+            << " (" << result.runs.size() << " runs x " << result.iterationCount << " iterations";
+        if (result.outlierCount != 0)
+            std::cout << ", outliers: " << result.outlierCount;
+        std::cout << ")";
+
+        if (m_baseline.count(result.GetKey()) != 0)
+        {
+            const auto change = GetChange(result);
+            std::cout << " " << (change > 0 ? "+" : "") << std::fixed << std::setprecision(1) << change*100 << "% vs baseline";
+            std::cout.unsetf(std::ios::floatfield);
+            if (change > m_options.regressionThreshold)
+                std::cout << " [REGRESSION]";
+        }
+        std::cout << std::endl;
+    }
+
+    static std::string Escape(const std::string& text)
+    {
+        std::string escaped;
+        for (const auto symbol : text)
+        {
+            if (symbol == '"' || symbol == '\\')
+                escaped += '\\';
+            escaped += symbol;
+        }
+        return escaped;
+    }
+
+    // Reads medians from JSON written by WriteJson (one benchmark per line).
+    static std::map<std::string, double> ReadJson(const std::string& path)
+    {
+        const auto readString = [](const std::string& line, const std::string& field) {
+            const auto key = "\"" + field + "\":\"";
+            auto position = line.find(key);
+            std::string value;
+            if (position == std::string::npos)
+                return value;
+            for (position += key.size(); position < line.size() && line[position] != '"'; ++position)
+            {
+                if (line[position] == '\\' && position + 1 < line.size())
+                    ++position;
+                value += line[position];
+            }
+            return value;
+        };
+
+        std::map<std::string, double> medians;
+        std::ifstream file{ path };
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const auto median = line.find("\"median\":");
+            if (median == std::string::npos)
+                continue;
+
+            BenchmarkResult result;
+            result.name = readString(line, "name");
+            result.description = readString(line, "description");
+            medians[result.GetKey()] = std::atof(line.c_str() + median + 9);
+        }
+
+        if (medians.empty())
+            std::cout << "Benchmark baseline " << path << " is empty or not found" << std::endl;
+        return medians;
+    }
+
+    BenchmarkOptions m_options;
+    std::vector<BenchmarkResult> m_results;
+    std::map<std::string, double> m_baseline; // Medians by key
+    std::string m_jsonPath;
+    std::string m_csvPath;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <new>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 /** The FixedFunction<RetValueType(Args...), StorageSize> class implements functional object.
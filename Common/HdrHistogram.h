@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/** The HdrHistogram class counts values (e.g. latencies in ns) in log-linear buckets like HdrHistogram:
+* values below 2^precisionBits are counted exactly, larger ones with relative error below 1/2^(precisionBits - 1)
+* (3% for default 6 bits), so the whole uint64_t range takes about 2k counters and percentiles of long tails stay accurate.
+*/
+class HdrHistogram
+{
+public:
+    explicit HdrHistogram(unsigned precisionBits = 6)
+        : m_precisionBits{ std::clamp(precisionBits, 2u, 16u) }
+        , m_counts(GetIndex(std::numeric_limits<uint64_t>::max()) + 1)
+    {}
+
+    void Record(uint64_t value, uint64_t count = 1)
+    {
+        m_counts[GetIndex(value)] += count;
+        m_totalCount += count;
+        m_sum += static_cast<double>(value)*static_cast<double>(count);
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    uint64_t GetCount() const
+    {
+        return m_totalCount;
+    }
+
+    uint64_t GetMin() const
+    {
+        return m_totalCount != 0 ? m_min : 0;
+    }
+
+    uint64_t GetMax() const
+    {
+        return m_max;
+    }
+
+    double GetMean() const
+    {
+        return m_totalCount != 0 ? m_sum/static_cast<double>(m_totalCount) : 0;
+    }
+
+    // Highest value equivalent to the value at the fraction (e.g. 0.999) of recorded ones, zero if there are no values.
+    uint64_t GetPercentile(double fraction) const
+    {
+        if (m_totalCount == 0)
+            return 0;
+
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction*static_cast<double>(m_totalCount))));
+        uint64_t seenCount = 0;
+        for (size_t index = 0; index != m_counts.size(); ++index)
+        {
+            seenCount += m_counts[index];
+            if (seenCount >= rank)
+                return std::min(GetHighestValue(index), m_max);
+        }
+        return m_max;
+    }
+
+    // Histograms must have the same precision.
+    HdrHistogram& operator+=(const HdrHistogram& other)
+    {
+        for (size_t index = 0; index != m_counts.size(); ++index)
+            m_counts[index] += other.m_counts[index];
+        m_totalCount += other.m_totalCount;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+        return *this;
+    }
+
+private:
+    // Values [0, 2^precisionBits) have own counters, then every power of two [2^n, 2^(n+1)) is split
+    // into 2^(precisionBits - 1) equal sub-buckets.
+    size_t GetIndex(uint64_t value) const
+    {
+        const auto bit = GetHighestBit(value);
+        if (value == 0 || bit < m_precisionBits)
+            return static_cast<size_t>(value);
+
+        const auto shift = bit - m_precisionBits + 1;
+        const auto halfCount = uint64_t{ 1 } << (m_precisionBits - 1);
+        const auto subBucket = (value >> shift) - halfCount;
+        return static_cast<size_t>((uint64_t{ 1 } << m_precisionBits) + (shift - 1)*halfCount + subBucket);
+    }
+
+    uint64_t GetHighestValue(size_t index) const
+    {
+        const auto count = uint64_t{ 1 } << m_precisionBits;
+        if (index < count)
+            return index;
+
+        const auto halfCount = count/2;
+        const auto shift = (index - count)/halfCount + 1;
+        const auto subBucket = halfCount + (index - count) % halfCount;
+        const auto lowestValue = subBucket << shift;
+        return lowestValue + ((uint64_t{ 1 } << shift) - 1);
+    }
+
+    static unsigned GetHighestBit(uint64_t value)
+    {
+        unsigned bit = 0;
+        for (unsigned step = 32; step != 0; step /= 2)
+        {
+            if ((value >> (bit + step)) != 0)
+                bit += step;
+        }
+        return bit;
+    }
+
+    unsigned              m_precisionBits;
+    std::vector<uint64_t> m_counts;
+    uint64_t              m_totalCount{ 0 };
+    double                m_sum{ 0 };
+    uint64_t              m_min{ std::numeric_limits<uint64_t>::max() };
+    uint64_t              m_max{ 0 };
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+/** Hints CPU that the calling thread is in a spin-wait loop.
+* On x86 it is 'pause' instruction: it saves power and avoids memory order violation penalty on loop exit.
+*/
+inline void CpuRelax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/** Waiting policy of idle threads: number of spinning and yielding iterations (see SpinWait) before parking.
+* Zero counts make a thread park immediately.
+*/
+struct WaitPolicy
+{
+    size_t spinCount{ 10 };
+    size_t yieldCount{ 10 };
+};
+
+/** The SpinWait class implements bounded spinning with exponential backoff.
+* - First spinCount iterations busy-wait on CPU: 1, 2, 4, ... (up to 64) relax instructions per iteration.
+* - Next yieldCount iterations give up time slice to other threads.
+* - After that SpinOnce() returns false: waiting is expected to be long, caller should park the thread.
+*/
+class SpinWait
+{
+public:
+    explicit SpinWait(size_t spinCount = 10, size_t yieldCount = 10)
+        : m_spinCount{ spinCount }
+        , m_yieldCount{ yieldCount }
+    {}
+
+    explicit SpinWait(const WaitPolicy& policy)
+        : SpinWait(policy.spinCount, policy.yieldCount)
+    {}
+
+    bool SpinOnce()
+    {
+        if (m_iteration < m_spinCount)
+        {
+            const auto relaxCount = size_t{ 1 } << std::min<size_t>(m_iteration, 6);
+            for (size_t n = 0; n != relaxCount; ++n)
+                CpuRelax();
+        }
+        else if (m_iteration < m_spinCount + m_yieldCount)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            return false;
+        }
+
+        ++m_iteration;
+        return true;
+    }
+
+    void Reset()
+    {
+        m_iteration = 0;
+    }
+
+private:
+    size_t m_spinCount;
+    size_t m_yieldCount;
+    size_t m_iteration{ 0 };
+};
@@ -1,8 +1,11 @@
 #include "TestUtilities.h"
 #include "Asynchronize.h"
 #include "FixedFunction.h"
+#include "HdrHistogram.h"
 #include "ZipIterator.h"
 
+#include <cmath>
+#include <limits>
 #include <string>
 #include <numeric>
 
@@ -130,8 +133,48 @@ void Test_StlTransfromZip()
      // TODO
 }
 
-int main()
+void Test_BenchmarkStatistics()
 {
+    BenchmarkResult result;
+    result.runs = { 5, 1, 4, 2, 3, 100, 6, 7, 8, 9 };
+    Benchmark::ComputeStatistics(result);
+
+    TEST_ASSERT(result.runs.front() == 1 && result.runs.back() == 100);
+    TEST_ASSERT(result.median == 5.5);
+    TEST_ASSERT(result.p90 == 9);
+    TEST_ASSERT(result.p99 == 100);
+    // 100 is out of Tukey fences, so it is not counted in mean.
+    TEST_ASSERT(result.outlierCount == 1);
+    TEST_ASSERT(result.mean == 5);
+}
+
+void Test_HdrHistogramPercentiles()
+{
+    HdrHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value)
+        histogram.Record(value*1000);
+
+    TEST_ASSERT(histogram.GetCount() == 1000);
+    TEST_ASSERT(histogram.GetMin() == 1000 && histogram.GetMax() == 1000000);
+    TEST_ASSERT(histogram.GetMean() == 500500);
+    // Values are equivalent within 1/32.
+    TEST_ASSERT(std::abs(static_cast<double>(histogram.GetPercentile(0.5))/500000 - 1) < 1.0/32);
+    TEST_ASSERT(std::abs(static_cast<double>(histogram.GetPercentile(0.99))/990000 - 1) < 1.0/32);
+    TEST_ASSERT(histogram.GetPercentile(1) == 1000000);
+
+    // Small values are exact.
+    HdrHistogram smallValues;
+    smallValues.Record(7, 3);
+    smallValues.Record(std::numeric_limits<uint64_t>::max());
+    TEST_ASSERT(smallValues.GetPercentile(0.75) == 7);
+    TEST_ASSERT(smallValues.GetPercentile(1) == std::numeric_limits<uint64_t>::max());
+}
+
+// Benchmark options are described in Benchmark.h.
+int main(int argc, char* argv[])
+{
+    Benchmark::Get().ParseArguments(argc, argv);
+
     std::cout << "==========================================" << std::endl;
     std::cout << "             FUNCTIONAL TESTS             " << std::endl;
     std::cout << "==========================================" << std::endl;
@@ -151,6 +194,11 @@ int main()
     DO_TEST(Test_StlAccumulateZip);
     std::cout << std::endl;
 
+    std::cout << "=            Test Benchmark              =" << std::endl;
+    DO_TEST(Test_BenchmarkStatistics);
+    DO_TEST(Test_HdrHistogramPercentiles);
+    std::cout << std::endl;
+
     std::cout << "==========================================" << std::endl;
     std::cout << "            PERFORMANCE TESTS             " << std::endl;
     std::cout << "==========================================" << std::endl;
@@ -166,5 +214,5 @@ int main()
     DO_BENCHMARK_TEST(1, Test_ParallelStringConcatenation);
     std::cout << std::endl;
 
-    return 0;
+    return Benchmark::Get().Finish() == 0 ? 0 : 1;
 }
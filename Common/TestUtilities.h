@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Benchmark.h"
 #include <string>
 #include <vector>
 #include <chrono>
@@ -20,7 +21,7 @@ inline void LoadCPUForRandomTime()
 
     volatile auto delay = rand() % static_cast<int>(1e5);
     while (delay != 0) {
-        delay--;
+        delay = delay - 1; // Compound operations on volatile are deprecated in C++20
     };
 }
 
@@ -85,29 +86,12 @@ private:
 
 using StopWatchMs = StopWatch<>;
 
-#define DO_BENCHMARK_TEST(repeatTimes, test) { \
-std::cout << " - Benchmark test ( " << #test; \
-StopWatchMs stopWatch; \
-for (size_t n = 0; n < repeatTimes; ++n) { \
-    stopWatch.Start(); \
-    test(); \
-    stopWatch.Stop(); \
-} \
-const auto history = stopWatch.GetHistory(); \
-std::cout << " ) => " << (std::accumulate(history.begin(), history.end(), StopWatchMs::TimeRep{}) / repeatTimes).count() << " ms" << std::endl; \
-}
+// Benchmarks are run by the harness (see Benchmark.h): repeatTimes is number of measured runs.
+#define DO_BENCHMARK_TEST(repeatTimes, test) \
+Benchmark::Get().Run(#test, "", repeatTimes, [] { test(); })
 
-#define DO_BENCHMARK_TEST_WITH_DESCRIPTION(description, repeatTimes, test) { \
-std::cout << " - Benchmark test ( " << #test << ", description: " << description; \
-StopWatchMs stopWatch; \
-for (size_t n = 0; n < repeatTimes; ++n) { \
-    stopWatch.Start(); \
-    test(); \
-    stopWatch.Stop(); \
-} \
-const auto history = stopWatch.GetHistory(); \
-std::cout << " ) => " << (std::accumulate(history.begin(), history.end(), StopWatchMs::TimeRep{}) / repeatTimes).count() << " ms" << std::endl; \
-}
+#define DO_BENCHMARK_TEST_WITH_DESCRIPTION(description, repeatTimes, test) \
+Benchmark::Get().Run(#test, description, repeatTimes, [] { test(); })
 
 #define TEST_ASSERT(expr) \
 if (!(expr)) { \
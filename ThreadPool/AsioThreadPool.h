@@ -1,67 +1,362 @@
 #pragma once
 
+#include "Cancellation.h"
+#include "Coroutine.h"
+#include "Future.h"
+#include "TaskGroup.h"
+#include "TaskQueue.h"
+#include "ThreadPoolOptions.h"
+#include "Strand.h"
+#include "ThreadPoolStats.h"
+#include "TimerWheel.h"
 #include <boost/asio.hpp>
-#include <future>
+#include <atomic>
+#include <functional>
 #include <vector>
 #include <memory>
 
+namespace detail
+{
+    /** Allocator associated with handlers of AsioThreadPool: asio allocates its operation (with the handler inside)
+    * through it, and memory of completed operations is recycled per thread (see RecyclingAllocator).
+    */
+    template <typename T>
+    class HandlerAllocator
+    {
+    public:
+        using value_type = T;
+
+        HandlerAllocator() = default;
+
+        template <typename U>
+        HandlerAllocator(const HandlerAllocator<U>&) noexcept {}
+
+        T* allocate(size_t count)
+        {
+            if (count == 1)
+                return static_cast<T*>(RecyclingAllocator<T>::Allocate());
+            return std::allocator<T>{}.allocate(count);
+        }
+
+        void deallocate(T* memory, size_t count) noexcept
+        {
+            if (count == 1)
+                RecyclingAllocator<T>::Deallocate(memory);
+            else
+                std::allocator<T>{}.deallocate(memory, count);
+        }
+
+        template <typename U>
+        bool operator==(const HandlerAllocator<U>&) const noexcept
+        {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const HandlerAllocator<U>&) const noexcept
+        {
+            return false;
+        }
+    };
+
+} // namespace detail
+
+/** Thread pool on top of boost::asio::io_context. By default all workers run one shared io_context;
+* with ThreadPoolOptions::ioContextPerThread every worker runs its own one and tasks are spread round robin,
+* so posting does not contend on a single queue and lock.
+*/
 class AsioThreadPool
 {
 public:
     explicit AsioThreadPool(size_t threadCount = std::max(2u, std::thread::hardware_concurrency()));
+    explicit AsioThreadPool(const ThreadPoolOptions& options);
     ~AsioThreadPool();
 
     template <typename TaskT>
-    auto ExecuteAsync(TaskT&& task) // TODO: Rename: Post
+    auto ExecuteAsync(TaskT&& task)
     {
-        using TaskRetType = decltype(task());
-        using PkgTask = std::packaged_task<TaskRetType()>;
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        Post(std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
 
-        // std::packaged_task<> is move only type.
-        // We need to wrap it in a shared_ptr to use in lambda.
-        auto job =
-            std::make_shared<PkgTask>(std::forward<TaskT>(task));
-        auto future = job->get_future();
+    // io_context has no priorities: tasks of any priority are executed in FIFO order.
+    template <typename TaskT>
+    auto ExecuteAsync(TaskPriority, TaskT&& task)
+    {
+        return ExecuteAsync(std::forward<TaskT>(task));
+    }
+
+    template <typename TaskT>
+    bool Post(TaskPriority, TaskT&& task)
+    {
+        return Post(std::forward<TaskT>(task));
+    }
 
-        m_ioService.post([job = std::move(job)]{ (*job)(); });
+    // Tasks posted after the pool is stopped are rejected (not consumed). io_context queue is unbounded.
+    template <typename TaskT>
+    bool Post(TaskT&& task)
+    {
+        if (m_stopped)
+            return false;
+
+        m_pending.Add();
+        boost::asio::post(SelectContext(), MakeHandler(std::forward<TaskT>(task)));
+        return true;
+    }
 
+    /** Tasks with equal keys are executed in order of posting, one at a time, tasks with different keys run in parallel.
+    * With io_context per thread key is hashed to a fixed io_context (so to one worker), otherwise to a strand.
+    */
+    template <typename KeyT, typename TaskT, typename = std::enable_if_t<detail::IsTaskKey<KeyT>>>
+    auto ExecuteAsync(const KeyT& key, TaskT&& task)
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        Post(key, std::move(job));
+        detail::RejectIfNotPosted(job);
         return future;
     }
 
+    template <typename KeyT, typename TaskT, typename = std::enable_if_t<detail::IsTaskKey<KeyT>>>
+    bool Post(const KeyT& key, TaskT&& task)
+    {
+        if (m_stopped)
+            return false;
+
+        const auto index = std::hash<KeyT>{}(key) % m_threads.size();
+        m_pending.Add();
+        if (m_contexts.size() != 1)
+            boost::asio::post(*m_contexts[index], MakeHandler(std::forward<TaskT>(task)));
+        else
+            boost::asio::post(m_strands[index], MakeHandler(std::forward<TaskT>(task)));
+        return true;
+    }
+
+    template <typename IteratorT>
+    auto ExecuteBatch(IteratorT first, IteratorT last)
+    {
+        std::vector<decltype(ExecuteAsync(*first))> futures;
+        for (; first != last; ++first)
+            futures.push_back(ExecuteAsync(*first));
+        return futures;
+    }
+
+    template <typename IteratorT>
+    size_t PostBatch(IteratorT first, IteratorT last)
+    {
+        size_t postedCount = 0;
+        for (; first != last && Post(*first); ++first)
+            ++postedCount;
+        return postedCount;
+    }
+
+    // Task is not run if the token is cancelled before a worker takes it: its future gets TaskCancelledError.
+    template <typename TaskT>
+    auto ExecuteAsync(const CancellationToken& token, TaskT&& task)
+    {
+        return ExecuteAsync(detail::MakeCancellableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // As ExecuteAsync with token, cancelled task is dropped. Unlike Post(task), rejected task is consumed.
+    template <typename TaskT>
+    bool Post(const CancellationToken& token, TaskT&& task)
+    {
+        return Post(detail::MakeSkippableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // Task is posted to the pool after the delay (see TimerWheel), the returned id cancels it.
+    template<typename TaskT>
+    TimerId ScheduleAfter(std::chrono::steady_clock::duration delay, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + delay, {}, std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    TimerId ScheduleAt(std::chrono::steady_clock::time_point time, TaskT&& task)
+    {
+        return m_timers.Schedule(time, {}, std::forward<TaskT>(task));
+    }
+
+    // Task is posted every period, the first time after one period.
+    template<typename TaskT>
+    TimerId SchedulePeriodic(std::chrono::steady_clock::duration period, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + period, period, std::forward<TaskT>(task));
+    }
+
+    // Returns false if the timer has already fired or been cancelled.
+    bool CancelTimer(TimerId id)
+    {
+        return m_timers.Cancel(id);
+    }
+
+#ifdef THREAD_POOL_COROUTINES
+    // co_await pool.Schedule() resumes the coroutine on a worker of the pool (see Coroutine.h).
+    ScheduleAwaiter Schedule()
+    {
+        return ScheduleAwaiter{ Executor{ *this } };
+    }
+#endif
+
+    size_t GetThreadCount() const
+    {
+        return m_threads.size();
+    }
+
+    // Waits until all posted tasks are done (including tasks posted by them). Must not be called from a task of the pool.
+    void WaitIdle()
+    {
+        m_pending.Wait();
+    }
+
+    // Snapshot of runtime statistics (io_context queue size and park time are not known).
+    ThreadPoolStats GetStats() const;
+
+    // Stops workers and cancels timers which have not fired, tasks posted after that are rejected. Destructor uses ShutdownMode::Discard.
+    void Shutdown(ShutdownMode mode = ShutdownMode::Drain);
+
 private:
+    using WorkGuardType = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    // Asio handler: move only tasks are moved in (no shared_ptr), memory is recycled by the associated allocator.
+    template <typename TaskT>
+    class Handler
+    {
+    public:
+        using allocator_type = detail::HandlerAllocator<Handler>;
+
+        template <typename F>
+        Handler(AsioThreadPool& pool, F&& task)
+            : m_pool{ &pool }
+            , m_task(std::forward<F>(task))
+        {}
+
+        allocator_type get_allocator() const noexcept
+        {
+            return {};
+        }
+
+        void operator()()
+        {
+            m_pool->Execute(m_task);
+        }
+
+    private:
+        AsioThreadPool* m_pool;
+        TaskT m_task;
+    };
+
+    template <typename TaskT>
+    auto MakeHandler(TaskT&& task)
+    {
+        auto stamped = detail::StampTask(std::forward<TaskT>(task));
+        return Handler<decltype(stamped)>{ *this, std::move(stamped) };
+    }
+
+    boost::asio::io_context& SelectContext()
+    {
+        if (m_contexts.size() == 1)
+            return *m_contexts.front();
+        return *m_contexts[m_contextIndex.fetch_add(1, std::memory_order_relaxed) % m_contexts.size()];
+    }
+
+    // Is called by handlers, they are executed only by workers of the pool.
+    template <typename TaskT>
+    void Execute(TaskT& task)
+    {
+        auto& stats = *detail::WorkerCounters::GetCurrent();
+        const auto startTime = stats.StartTask();
+        task();
+        stats.FinishTask(startTime);
+        m_pending.Done();
+    }
+
     void Start();
     void Stop();
-    void Run();
+    void Run(size_t index);
 
-    boost::asio::io_service m_ioService;
-    std::unique_ptr<boost::asio::io_service::work> m_work{ std::make_unique<boost::asio::io_service::work>(m_ioService) };
+    detail::TaskCounter m_pending; // Posted and running handlers
+    std::atomic<bool> m_stopped{ false };
+    std::vector<std::unique_ptr<boost::asio::io_context>> m_contexts; // One shared or one per worker
+    std::vector<WorkGuardType> m_work;
+    std::vector<boost::asio::io_context::strand> m_strands; // Keyed tasks with shared io_context
+    std::atomic<size_t> m_contextIndex{ 0 };
+    detail::WorkerPlacement m_placement;
+    std::vector<detail::WorkerCounters> m_stats;
     std::vector<std::thread> m_threads;
+    TimerWheel m_timers;
 
     AsioThreadPool(const AsioThreadPool&) = delete;
     AsioThreadPool& operator=(const AsioThreadPool&) = delete;
 };
 
 AsioThreadPool::AsioThreadPool(size_t threadCount)
-    : m_threads(threadCount)
+    : AsioThreadPool(ThreadPoolOptions{ threadCount })
+{}
+
+AsioThreadPool::AsioThreadPool(const ThreadPoolOptions& options)
+    : m_placement{ options.threadCount, options.affinity }
+    , m_stats(options.threadCount)
+    , m_threads(options.threadCount)
+    , m_timers{ Executor{ *this }, options.timerResolution }
 {
+    // Concurrency hint 1 lets io_context of a single worker skip some locking.
+    if (options.ioContextPerThread && options.threadCount > 1)
+    {
+        for (size_t index = 0; index != options.threadCount; ++index)
+            m_contexts.push_back(std::make_unique<boost::asio::io_context>(1));
+    }
+    else
+    {
+        m_contexts.push_back(std::make_unique<boost::asio::io_context>(static_cast<int>(options.threadCount)));
+        for (size_t index = 0; index != options.threadCount; ++index)
+            m_strands.emplace_back(*m_contexts.front());
+    }
+
+    for (auto& context : m_contexts)
+        m_work.push_back(boost::asio::make_work_guard(*context));
+
     Start();
 }
 
 AsioThreadPool::~AsioThreadPool()
 {
+    Shutdown(ShutdownMode::Discard);
+}
+
+void AsioThreadPool::Shutdown(ShutdownMode mode)
+{
+    m_timers.Stop();
+
+    if (mode == ShutdownMode::Drain)
+        WaitIdle();
+
     Stop();
 }
 
+ThreadPoolStats AsioThreadPool::GetStats() const
+{
+    auto stats = detail::CollectStats(m_stats);
+    stats.threadCount = m_threads.size();
+    stats.pendingCount = m_pending.GetCount();
+    return stats;
+}
+
 void AsioThreadPool::Start()
 {
-    for (auto& thread : m_threads)
-        thread = std::thread(&AsioThreadPool::Run, this);
+    for (size_t index = 0; index != m_threads.size(); ++index)
+        m_threads[index] = std::thread(&AsioThreadPool::Run, this, index);
 }
 
 void AsioThreadPool::Stop()
 {
-    m_work.reset();
-    m_ioService.stop();
+    m_stopped = true;
+    m_work.clear();
+    for (auto& context : m_contexts)
+        context->stop();
 
     for (auto& thread : m_threads)
     {
@@ -70,7 +365,9 @@ void AsioThreadPool::Stop()
     }
 }
 
-void AsioThreadPool::Run()
+void AsioThreadPool::Run(size_t index)
 {
-    m_ioService.run();
+    m_placement.Apply(index);
+    m_stats[index].MakeCurrent();
+    m_contexts[m_contexts.size() != 1 ? index : 0]->run();
 }
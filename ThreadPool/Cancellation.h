@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/** Is stored in futures of tasks which were cancelled (see CancellationSource) before a worker started them. */
+class TaskCancelledError : public std::runtime_error
+{
+public:
+    TaskCancelledError() : std::runtime_error{ "Task is cancelled" } {}
+};
+
+/** The CancellationToken class is the observer side of CancellationSource, it is cheap to copy.
+* Default constructed token is never cancelled. Long task may poll the token of itself (CancellationToken::GetCurrent())
+* and stop early.
+*/
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+
+    bool IsCancellationRequested() const noexcept
+    {
+        return m_state && m_state->load(std::memory_order_acquire);
+    }
+
+    void ThrowIfCancellationRequested() const
+    {
+        if (IsCancellationRequested())
+            throw TaskCancelledError{};
+    }
+
+    bool CanBeCancelled() const noexcept
+    {
+        return m_state != nullptr;
+    }
+
+    // Token of the cancellable task being executed by the calling thread (token which is never cancelled otherwise).
+    static const CancellationToken& GetCurrent() noexcept
+    {
+        static const CancellationToken none;
+        const auto* current = GetCurrentSlot();
+        return current ? *current : none;
+    }
+
+private:
+    friend class CancellationSource;
+    friend class CurrentCancellationScope;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> state) : m_state{ std::move(state) } {}
+
+    static const CancellationToken*& GetCurrentSlot() noexcept
+    {
+        static thread_local const CancellationToken* current{ nullptr };
+        return current;
+    }
+
+    std::shared_ptr<const std::atomic<bool>> m_state;
+};
+
+/** The CancellationSource class requests cancellation of tasks submitted with its tokens:
+* tasks which have not started yet are dropped by workers without running (their futures get TaskCancelledError),
+* running ones see it through their token. Cancellation can't be undone.
+*/
+class CancellationSource
+{
+public:
+    CancellationSource() = default;
+
+    CancellationToken GetToken() const
+    {
+        return CancellationToken{ m_state };
+    }
+
+    void Cancel() noexcept
+    {
+        m_state->store(true, std::memory_order_release);
+    }
+
+    bool IsCancellationRequested() const noexcept
+    {
+        return m_state->load(std::memory_order_acquire);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_state{ std::make_shared<std::atomic<bool>>(false) };
+};
+
+/** Makes the token current for the calling thread (see CancellationToken::GetCurrent()) till the end of the scope. */
+class CurrentCancellationScope
+{
+public:
+    explicit CurrentCancellationScope(const CancellationToken& token) noexcept
+        : m_previous{ std::exchange(CancellationToken::GetCurrentSlot(), &token) }
+    {}
+
+    ~CurrentCancellationScope()
+    {
+        CancellationToken::GetCurrentSlot() = m_previous;
+    }
+
+private:
+    CurrentCancellationScope(const CurrentCancellationScope&) = delete;
+    CurrentCancellationScope& operator=(const CurrentCancellationScope&) = delete;
+
+    const CancellationToken* m_previous;
+};
+
+namespace detail
+{
+    /** Task submitted with a token. Token is checked when a worker takes the task: cancelled task is not run,
+    * it throws TaskCancelledError instead (so packaged task completes its future with it) or is skipped silently.
+    * Tasks submitted without token are not wrapped, so they don't pay for cancellation.
+    */
+    template <typename FuncT, bool ThrowIfCancelled>
+    class CancellableTask
+    {
+    public:
+        template <typename F>
+        CancellableTask(CancellationToken token, F&& func)
+            : m_token{ std::move(token) }
+            , m_func(std::forward<F>(func))
+        {}
+
+        using ResultType = std::conditional_t<ThrowIfCancelled, std::invoke_result_t<FuncT&>, void>;
+
+        ResultType operator()()
+        {
+            if constexpr (ThrowIfCancelled)
+            {
+                m_token.ThrowIfCancellationRequested();
+                const CurrentCancellationScope scope{ m_token };
+                return m_func();
+            }
+            else
+            {
+                if (m_token.IsCancellationRequested())
+                    return;
+                const CurrentCancellationScope scope{ m_token };
+                m_func();
+            }
+        }
+
+    private:
+        CancellationToken m_token;
+        FuncT m_func;
+    };
+
+    // For ExecuteAsync: future of cancelled task gets TaskCancelledError.
+    template <typename FuncT>
+    auto MakeCancellableTask(const CancellationToken& token, FuncT&& func)
+    {
+        return CancellableTask<std::decay_t<FuncT>, true>{ token, std::forward<FuncT>(func) };
+    }
+
+    // For Post: cancelled task is just dropped.
+    template <typename FuncT>
+    auto MakeSkippableTask(const CancellationToken& token, FuncT&& func)
+    {
+        return CancellableTask<std::decay_t<FuncT>, false>{ token, std::forward<FuncT>(func) };
+    }
+
+} // namespace detail
@@ -0,0 +1,349 @@
+#pragma once
+
+#include "Future.h"
+
+// Coroutine support needs C++20 coroutines (e.g. -std=c++20 or /std:c++latest), otherwise this header is empty.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define THREAD_POOL_COROUTINES 1
+#endif
+#endif
+
+#ifdef THREAD_POOL_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/** Awaitable returned by Schedule() of thread pools: co_await pool.Schedule() resumes the coroutine on a worker of the pool.
+* If the pool rejects the task (see Executor), the coroutine is resumed in place. If the pool discards queued tasks
+* on shutdown, the coroutine is never resumed (its owner destroys it).
+*/
+class ScheduleAwaiter
+{
+public:
+    explicit ScheduleAwaiter(const Executor& executor) : m_executor{ executor } {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        m_executor.Post([handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    Executor m_executor;
+};
+
+/** Awaitable of Future<T>: the coroutine is resumed as continuation of the future (on the pool which produced the result),
+* no thread is blocked waiting for it. As get() it consumes the future.
+*/
+template <typename T>
+class FutureAwaiter
+{
+public:
+    explicit FutureAwaiter(Future<T>&& future) : m_future{ std::move(future) } {}
+
+    bool await_ready() const
+    {
+        return m_future.is_ready();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        detail::FutureAccess::GetState(m_future)->AddContinuation(detail::MakeCallback([handle] { handle.resume(); }));
+    }
+
+    T await_resume()
+    {
+        return m_future.get();
+    }
+
+private:
+    Future<T> m_future;
+};
+
+template <typename T>
+FutureAwaiter<T> operator co_await(Future<T>&& future)
+{
+    return FutureAwaiter<T>{ std::move(future) };
+}
+
+template <typename T = void>
+class CoroutineTask;
+
+namespace detail
+{
+    class TaskPromiseBase
+    {
+    public:
+        // Task is lazy: it starts when it is awaited.
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        // Symmetric transfer: finished task resumes its awaiter without growing the stack.
+        auto final_suspend() const noexcept
+        {
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                void await_resume() const noexcept {}
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept
+                {
+                    return continuation;
+                }
+
+                std::coroutine_handle<> continuation;
+            };
+            return FinalAwaiter{ m_continuation };
+        }
+
+        void unhandled_exception() noexcept
+        {
+            m_exception = std::current_exception();
+        }
+
+        void SetContinuation(std::coroutine_handle<> continuation) noexcept
+        {
+            m_continuation = continuation;
+        }
+
+    protected:
+        void RethrowIfFailed() const
+        {
+            if (m_exception)
+                std::rethrow_exception(m_exception);
+        }
+
+    private:
+        std::coroutine_handle<> m_continuation{ std::noop_coroutine() };
+        std::exception_ptr      m_exception;
+    };
+
+    template <typename T>
+    class TaskPromise : public TaskPromiseBase
+    {
+    public:
+        CoroutineTask<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U&& value)
+        {
+            m_value.emplace(std::forward<U>(value));
+        }
+
+        T GetResult()
+        {
+            RethrowIfFailed();
+            return std::move(*m_value);
+        }
+
+    private:
+        std::optional<T> m_value;
+    };
+
+    template <>
+    class TaskPromise<void> : public TaskPromiseBase
+    {
+    public:
+        CoroutineTask<void> get_return_object() noexcept;
+
+        void return_void() const noexcept {}
+
+        void GetResult() const
+        {
+            RethrowIfFailed();
+        }
+    };
+
+} // namespace detail
+
+/** The CoroutineTask<T> class is a lazy coroutine: it starts when it is awaited and resumes the awaiting coroutine
+* by symmetric transfer when it is done (result or exception is passed to the awaiter).
+* Use co_await pool.Schedule() inside the task to move it to a pool, or Spawn() to run it on a pool from ordinary code.
+*/
+template <typename T>
+class [[nodiscard]] CoroutineTask
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    CoroutineTask(CoroutineTask&& other) noexcept
+        : m_handle{ std::exchange(other.m_handle, nullptr) }
+    {}
+
+    CoroutineTask& operator=(CoroutineTask&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~CoroutineTask()
+    {
+        Reset();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept
+            {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept
+            {
+                handle.promise().SetContinuation(awaiting);
+                return handle;
+            }
+
+            T await_resume() const
+            {
+                if (!handle)
+                    throw std::future_error(std::future_errc::no_state);
+                return handle.promise().GetResult();
+            }
+        };
+        return Awaiter{ m_handle };
+    }
+
+private:
+    friend class detail::TaskPromise<T>;
+
+    explicit CoroutineTask(std::coroutine_handle<promise_type> handle) : m_handle{ handle } {}
+
+    CoroutineTask(const CoroutineTask&) = delete;
+    CoroutineTask& operator=(const CoroutineTask&) = delete;
+
+    void Reset()
+    {
+        if (m_handle)
+            std::exchange(m_handle, nullptr).destroy();
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace detail
+{
+    template <typename T>
+    CoroutineTask<T> TaskPromise<T>::get_return_object() noexcept
+    {
+        return CoroutineTask<T>{ std::coroutine_handle<TaskPromise>::from_promise(*this) };
+    }
+
+    inline CoroutineTask<void> TaskPromise<void>::get_return_object() noexcept
+    {
+        return CoroutineTask<void>{ std::coroutine_handle<TaskPromise>::from_promise(*this) };
+    }
+
+    // Fire and forget coroutine: it owns itself and is destroyed when it finishes.
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    // As ScheduleAwaiter, but the detached coroutine is destroyed if the pool drops it (queued tasks are discarded on shutdown).
+    class DetachedScheduleAwaiter
+    {
+    public:
+        explicit DetachedScheduleAwaiter(const Executor& executor) : m_executor{ executor } {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) const
+        {
+            struct Resumer
+            {
+                explicit Resumer(std::coroutine_handle<> handle) : m_handle{ handle } {}
+                Resumer(Resumer&& other) noexcept : m_handle{ std::exchange(other.m_handle, nullptr) } {}
+                Resumer& operator=(Resumer&&) = delete;
+
+                ~Resumer()
+                {
+                    if (m_handle)
+                        m_handle.destroy();
+                }
+
+                void operator()()
+                {
+                    std::exchange(m_handle, nullptr).resume();
+                }
+
+                std::coroutine_handle<> m_handle;
+            };
+
+            m_executor.Post(Resumer{ handle });
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        Executor m_executor;
+    };
+
+    template <typename T>
+    DetachedTask RunTask(Executor executor, CoroutineTask<T> task, Promise<T> promise)
+    {
+        co_await DetachedScheduleAwaiter{ executor };
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await std::move(task);
+                promise.set_value();
+            }
+            else
+            {
+                promise.set_value(co_await std::move(task));
+            }
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    }
+
+} // namespace detail
+
+/** Starts the task on a worker of the pool, result is returned as future (continuations of which run on the same pool),
+* so the future may be awaited by other coroutines as well. Task dropped by the pool on shutdown gets broken promise.
+*/
+template <typename PoolT, typename T>
+Future<T> Spawn(PoolT& pool, CoroutineTask<T> task)
+{
+    const Executor executor{ pool };
+    Promise<T> promise;
+    auto future = promise.get_future(executor);
+    detail::RunTask(executor, std::move(task), std::move(promise));
+    return future;
+}
+
+#endif // THREAD_POOL_COROUTINES
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+/** The CpuTopology class describes CPUs available to the process grouped by NUMA nodes.
+* On Linux it is read from /sys/devices/system/node and /sys/devices/system/cpu (restricted by the process affinity mask),
+* on other platforms (or if sysfs is not available) all std::thread::hardware_concurrency() CPUs belong to one node.
+*/
+class CpuTopology
+{
+public:
+    static const CpuTopology& Get()
+    {
+        static const CpuTopology topology;
+        return topology;
+    }
+
+    size_t GetNodeCount() const
+    {
+        return m_nodes.size();
+    }
+
+    const std::vector<size_t>& GetNodeCpus(size_t node) const
+    {
+        return m_nodes[node];
+    }
+
+    // CPUs ordered node by node.
+    const std::vector<size_t>& GetCpus() const
+    {
+        return m_cpus;
+    }
+
+    size_t GetCpuNode(size_t cpu) const
+    {
+        for (size_t node = 0; node != m_nodes.size(); ++node)
+        {
+            if (std::find(m_nodes[node].begin(), m_nodes[node].end(), cpu) != m_nodes[node].end())
+                return node;
+        }
+        return 0;
+    }
+
+    // Parses sysfs list format, e.g. "0-3,8,10-11".
+    static std::vector<size_t> ParseCpuList(const std::string& list)
+    {
+        std::vector<size_t> cpus;
+        std::istringstream stream{ list };
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            const auto dash = range.find('-');
+            try
+            {
+                const auto first = std::stoul(range.substr(0, dash));
+                const auto last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+                for (auto cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+            catch (const std::exception&)
+            {
+                // Malformed or empty entry (e.g. trailing new line) is ignored.
+            }
+        }
+        return cpus;
+    }
+
+private:
+    CpuTopology()
+    {
+        auto allowedCpus = ReadList("/sys/devices/system/cpu/online");
+#if defined(__linux__)
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+        if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+        {
+            allowedCpus.erase(std::remove_if(allowedCpus.begin(), allowedCpus.end(), [&affinity](size_t cpu) {
+                return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &affinity);
+            }), allowedCpus.end());
+        }
+#endif
+        if (allowedCpus.empty())
+        {
+            for (size_t cpu = 0; cpu != std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                allowedCpus.push_back(cpu);
+        }
+
+        for (const auto node : ReadList("/sys/devices/system/node/online"))
+        {
+            auto nodeCpus = ReadList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            nodeCpus.erase(std::remove_if(nodeCpus.begin(), nodeCpus.end(), [&allowedCpus](size_t cpu) {
+                return std::find(allowedCpus.begin(), allowedCpus.end(), cpu) == allowedCpus.end();
+            }), nodeCpus.end());
+
+            if (!nodeCpus.empty())
+                m_nodes.push_back(std::move(nodeCpus));
+        }
+
+        if (m_nodes.empty())
+            m_nodes.push_back(allowedCpus);
+
+        for (const auto& nodeCpus : m_nodes)
+            m_cpus.insert(m_cpus.end(), nodeCpus.begin(), nodeCpus.end());
+    }
+
+    static std::vector<size_t> ReadList(const std::string& path)
+    {
+        std::ifstream file{ path };
+        std::string list;
+        std::getline(file, list);
+        return ParseCpuList(list);
+    }
+
+    std::vector<std::vector<size_t>> m_nodes;
+    std::vector<size_t>              m_cpus;
+};
+
+// Binds the calling thread to the CPUs, returns false if it is not supported by the platform or failed.
+inline bool SetCurrentThreadAffinity(const std::vector<size_t>& cpus)
+{
+#if defined(__linux__)
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    for (const auto cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &affinity);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity) == 0;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (const auto cpu : cpus)
+    {
+        if (cpu < sizeof(mask)*8)
+            mask |= DWORD_PTR{ 1 } << cpu;
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
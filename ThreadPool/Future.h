@@ -0,0 +1,869 @@
+#pragma once
+
+#include "Common/FixedFunction.h"
+#include "Common/SpinWait.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class Future;
+
+template <typename T>
+class Promise;
+
+namespace detail
+{
+    using Callback = FixedFunction<void(), 64>;
+
+    template <typename FuncT>
+    Callback MakeCallback(FuncT&& func)
+    {
+        using FuncType = std::decay_t<FuncT>;
+
+        if constexpr (std::is_same_v<FuncType, Callback>)
+        {
+            return std::forward<FuncT>(func);
+        }
+        else if constexpr (sizeof(FuncType) < 64 && alignof(FuncType) <= alignof(size_t))
+        {
+            return Callback{ [func = FuncType(std::forward<FuncT>(func))]() mutable { func(); } };
+        }
+        else
+        {
+            return Callback{ [func = std::make_unique<FuncType>(std::forward<FuncT>(func))] { (*func)(); } };
+        }
+    }
+
+} // namespace detail
+
+/** The Executor class is type-erased reference to a thread pool (anything with Post(task) method).
+* Default constructed executor runs tasks in place, as well as tasks rejected by the pool
+* (Post returned false, e.g. bounded queue is full), so continuations are never lost.
+* Thread pool must outlive executors referring to it.
+*/
+class Executor
+{
+public:
+    Executor() = default;
+
+    template <typename PoolT, typename = std::enable_if_t<!std::is_same_v<std::decay_t<PoolT>, Executor>>>
+    explicit Executor(PoolT& pool)
+        : m_pool{ &pool }
+        , m_post{ [](void* pool, detail::Callback&& task) {
+            if constexpr (std::is_same_v<decltype(static_cast<PoolT*>(pool)->Post(std::move(task))), bool>)
+            {
+                return static_cast<PoolT*>(pool)->Post(std::move(task));
+            }
+            else
+            {
+                static_cast<PoolT*>(pool)->Post(std::move(task));
+                return true;
+            }
+        } }
+    {}
+
+    template <typename TaskT>
+    void Post(TaskT&& task) const
+    {
+        // Rejected task is not consumed by the pool.
+        auto callback = detail::MakeCallback(std::forward<TaskT>(task));
+        if (!m_post || !m_post(m_pool, std::move(callback)))
+            callback();
+    }
+
+    explicit operator bool() const
+    {
+        return m_post != nullptr;
+    }
+
+private:
+    using PostType = bool(*)(void* pool, detail::Callback&& task);
+
+    void*    m_pool{ nullptr };
+    PostType m_post{ nullptr };
+};
+
+namespace detail
+{
+    // Threads blocked on futures are parked on a small fixed set of mutexes/condition variables,
+    // so a shared state carries only an atomic flags word instead of its own mutex and condition variable.
+    struct alignas(64) ParkingBucket
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    inline ParkingBucket& GetParkingBucket(const void* address)
+    {
+        constexpr size_t BucketCount = 64;
+        static ParkingBucket buckets[BucketCount];
+        return buckets[(reinterpret_cast<std::uintptr_t>(address) >> 4) % BucketCount];
+    }
+
+    /** Per-thread cache of memory blocks for objects of type T.
+    * Freed blocks are kept in intrusive free list and reused by next allocation on the same thread,
+    * so in steady state shared states are not allocated from the heap.
+    */
+    template <typename T>
+    class RecyclingAllocator
+    {
+        struct Block { Block* next; };
+        static constexpr size_t BlockSize = std::max(sizeof(T), sizeof(Block));
+        static constexpr size_t MaxCachedBlocks = 1024;
+
+        struct Cache
+        {
+            Block* head{ nullptr };
+            size_t size{ 0 };
+
+            ~Cache()
+            {
+                while (head)
+                    ::operator delete(std::exchange(head, head->next));
+                Destroyed() = true;
+            }
+        };
+
+        static Cache& GetCache()
+        {
+            static thread_local Cache cache;
+            return cache;
+        }
+
+        static bool& Destroyed()
+        {
+            static thread_local bool destroyed{ false };
+            return destroyed;
+        }
+
+    public:
+        static void* Allocate()
+        {
+            if (!Destroyed())
+            {
+                auto& cache = GetCache();
+                if (cache.head)
+                {
+                    --cache.size;
+                    return std::exchange(cache.head, cache.head->next);
+                }
+            }
+
+            return ::operator new(BlockSize);
+        }
+
+        static void Deallocate(void* memory) noexcept
+        {
+            // Thread local cache may be already destroyed if state is released during thread exit.
+            if (!Destroyed())
+            {
+                auto& cache = GetCache();
+                if (cache.size < MaxCachedBlocks)
+                {
+                    cache.head = new (memory) Block{ cache.head };
+                    ++cache.size;
+                    return;
+                }
+            }
+
+            ::operator delete(memory);
+        }
+    };
+
+    /** Shared state of Promise/Future pair.
+    * Reference counter is intrusive, memory is recycled by RecyclingAllocator.
+    * Waiting is spin-then-park: waiter spins for a while, then announces itself (Waiting flag) and parks,
+    * producer touches parking bucket only if somebody is actually waiting.
+    */
+    template <typename T>
+    class FutureState
+    {
+        struct Void {};
+        // Reference result (as for 'std::future<T&>') is stored as reference_wrapper, Get() converts it back.
+        using ValueType = std::conditional_t<std::is_void_v<T>, Void,
+            std::conditional_t<std::is_reference_v<T>, std::reference_wrapper<std::remove_reference_t<T>>, T>>;
+
+        enum Flags : unsigned { Ready = 1, Waiting = 2, HasContinuation = 4, ContinuationLock = 8 };
+
+    public:
+        static FutureState* Create()
+        {
+            return new (RecyclingAllocator<FutureState>::Allocate()) FutureState;
+        }
+
+        void AddRef()
+        {
+            m_refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void Release()
+        {
+            if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                this->~FutureState();
+                RecyclingAllocator<FutureState>::Deallocate(this);
+            }
+        }
+
+        bool IsReady() const
+        {
+            return (m_flags.load(std::memory_order_acquire) & Ready) != 0;
+        }
+
+        void SetExecutor(const Executor& executor)
+        {
+            m_executor = executor;
+        }
+
+        const Executor& GetExecutor() const
+        {
+            return m_executor;
+        }
+
+        /**
+        * Continuation is posted to executor of the state (or run in place if there is no executor) once state is ready.
+        * If state is already ready continuation is posted immediately.
+        */
+        void AddContinuation(Callback&& continuation)
+        {
+            if (IsReady())
+            {
+                m_executor.Post(std::move(continuation));
+                return;
+            }
+
+            LockContinuation();
+            if (m_continuation)
+            {
+                m_continuation = MakeCallback([first = std::move(m_continuation), second = std::move(continuation)]() mutable {
+                    first();
+                    second();
+                });
+            }
+            else
+            {
+                m_continuation = std::move(continuation);
+            }
+
+            // If state became ready before the flag was set, Complete() has not seen the continuation: run it here.
+            const bool ready = (m_flags.fetch_or(HasContinuation, std::memory_order_acq_rel) & Ready) != 0;
+            auto readyContinuation = ready ? std::move(m_continuation) : Callback{};
+            UnlockContinuation();
+
+            if (readyContinuation)
+                m_executor.Post(std::move(readyContinuation));
+        }
+
+        template <typename... ArgsT>
+        void SetValue(ArgsT&&... args)
+        {
+            m_value.emplace(std::forward<ArgsT>(args)...);
+            Complete();
+        }
+
+        void SetException(std::exception_ptr exception)
+        {
+            m_exception = std::move(exception);
+            Complete();
+        }
+
+        void Wait()
+        {
+            for (SpinWait spinWait; !IsReady();)
+            {
+                if (!spinWait.SpinOnce())
+                {
+                    auto& bucket = GetParkingBucket(this);
+                    std::unique_lock<std::mutex> lock{ bucket.mutex };
+                    if (m_flags.fetch_or(Waiting, std::memory_order_acq_rel) & Ready)
+                        return;
+                    bucket.condition.wait(lock, [this] { return IsReady(); });
+                }
+            }
+        }
+
+        template <typename ClockT, typename DurationT>
+        bool WaitUntil(const std::chrono::time_point<ClockT, DurationT>& timeout)
+        {
+            for (SpinWait spinWait; !IsReady();)
+            {
+                if (ClockT::now() >= timeout)
+                    return false;
+
+                if (!spinWait.SpinOnce())
+                {
+                    auto& bucket = GetParkingBucket(this);
+                    std::unique_lock<std::mutex> lock{ bucket.mutex };
+                    if (m_flags.fetch_or(Waiting, std::memory_order_acq_rel) & Ready)
+                        return true;
+                    return bucket.condition.wait_until(lock, timeout, [this] { return IsReady(); });
+                }
+            }
+            return true;
+        }
+
+        T Get()
+        {
+            Wait();
+
+            if (m_exception)
+                std::rethrow_exception(m_exception);
+
+            if constexpr (!std::is_void_v<T>)
+                return std::move(*m_value);
+        }
+
+    private:
+        FutureState() = default;
+
+        void Complete()
+        {
+            const auto flags = m_flags.fetch_or(Ready, std::memory_order_acq_rel);
+
+            if (flags & Waiting)
+            {
+                // Bucket is shared by several states, so everybody is woken up to recheck.
+                auto& bucket = GetParkingBucket(this);
+                { std::lock_guard<std::mutex> lock{ bucket.mutex }; }
+                bucket.condition.notify_all();
+            }
+
+            if (flags & HasContinuation)
+            {
+                LockContinuation();
+                auto continuation = std::move(m_continuation);
+                UnlockContinuation();
+
+                // AddContinuation may have taken it already (it saw Ready before this lock).
+                if (continuation)
+                    m_executor.Post(std::move(continuation));
+            }
+        }
+
+        void LockContinuation()
+        {
+            while (m_flags.fetch_or(ContinuationLock, std::memory_order_acquire) & ContinuationLock)
+                CpuRelax();
+        }
+
+        void UnlockContinuation()
+        {
+            m_flags.fetch_and(~unsigned{ ContinuationLock }, std::memory_order_release);
+        }
+
+        std::atomic<unsigned>   m_refCount{ 1 };
+        std::atomic<unsigned>   m_flags{ 0 };
+        std::exception_ptr      m_exception;
+        std::optional<ValueType> m_value;
+        Executor                m_executor;
+        Callback                m_continuation;
+    };
+
+    struct FutureAccess
+    {
+        template <typename T>
+        static FutureState<T>* GetState(const Future<T>& future)
+        {
+            return future.m_state;
+        }
+    };
+
+    template <typename ResultT, typename FuncT, typename... ArgsT>
+    void SetPromiseResult(Promise<ResultT>& promise, FuncT& func, ArgsT&&... args)
+    {
+        try
+        {
+            if constexpr (std::is_void_v<ResultT>)
+            {
+                std::invoke(func, std::forward<ArgsT>(args)...);
+                promise.set_value();
+            }
+            else
+            {
+                promise.set_value(std::invoke(func, std::forward<ArgsT>(args)...));
+            }
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    }
+
+    template <typename T>
+    class FutureStateRef
+    {
+    public:
+        explicit FutureStateRef(FutureState<T>* state) : m_state{ state } {}
+        ~FutureStateRef() { if (m_state) m_state->Release(); }
+        FutureState<T>* operator->() const { return m_state; }
+
+    private:
+        FutureStateRef(const FutureStateRef&) = delete;
+        FutureStateRef& operator=(const FutureStateRef&) = delete;
+
+        FutureState<T>* m_state;
+    };
+
+} // namespace detail
+
+/** The Future<T> class is lightweight analog of 'std::future' returned by thread pools.
+* - Interface is compatible with 'std::future': get(), wait(), wait_for(), wait_until(), valid().
+* - Shared state is recycled per thread and waiting spins before parking the thread in the kernel.
+*/
+template <typename T>
+class Future
+{
+public:
+    Future() = default;
+
+    Future(Future&& other) noexcept
+        : m_state{ std::exchange(other.m_state, nullptr) }
+    {}
+
+    Future& operator=(Future&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    ~Future()
+    {
+        Reset();
+    }
+
+    bool valid() const noexcept
+    {
+        return m_state != nullptr;
+    }
+
+    bool is_ready() const
+    {
+        CheckState();
+        return m_state->IsReady();
+    }
+
+    void wait() const
+    {
+        CheckState();
+        m_state->Wait();
+    }
+
+    template <typename RepT, typename PeriodT>
+    std::future_status wait_for(const std::chrono::duration<RepT, PeriodT>& timeout) const
+    {
+        return wait_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename ClockT, typename DurationT>
+    std::future_status wait_until(const std::chrono::time_point<ClockT, DurationT>& timeout) const
+    {
+        CheckState();
+        return m_state->WaitUntil(timeout) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    /**
+    * Waits for result and returns it (or rethrows stored exception).
+    * As for 'std::future' the future is not valid after this call.
+    */
+    T get()
+    {
+        CheckState();
+        detail::FutureStateRef<T> state{ std::exchange(m_state, nullptr) };
+        return state->Get();
+    }
+
+    /**
+    * Attaches continuation: func(Future<T>) is called with ready future once result is available.
+    * Continuation is scheduled on the same thread pool as the task of this future, nobody blocks waiting for it.
+    * As get() it invalidates the future, the result of continuation is returned as new future.
+    */
+    template <typename FuncT>
+    auto Then(FuncT&& func)
+    {
+        CheckState();
+
+        using FuncType = std::decay_t<FuncT>;
+        using ResultType = std::invoke_result_t<FuncType&, Future<T>>;
+
+        auto* state = m_state;
+        Promise<ResultType> promise;
+        auto result = promise.get_future(state->GetExecutor());
+
+        state->AddContinuation(detail::MakeCallback(
+            [parent = std::move(*this), promise = std::move(promise), func = FuncType(std::forward<FuncT>(func))]() mutable {
+                detail::SetPromiseResult(promise, func, std::move(parent));
+            }));
+
+        return result;
+    }
+
+private:
+    template <typename>
+    friend class Promise;
+    friend struct detail::FutureAccess;
+
+    explicit Future(detail::FutureState<T>* state) : m_state{ state } {}
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    void CheckState() const
+    {
+        if (!m_state)
+            throw std::future_error(std::future_errc::no_state);
+    }
+
+    void Reset()
+    {
+        if (m_state)
+            std::exchange(m_state, nullptr)->Release();
+    }
+
+    detail::FutureState<T>* m_state{ nullptr };
+};
+
+/** The Promise<T> class is producer side of Future<T>, analog of 'std::promise'.
+* If promise is destroyed without result, future gets 'std::future_error' with broken promise error code.
+*/
+template <typename T>
+class Promise
+{
+public:
+    Promise()
+        : m_state{ detail::FutureState<T>::Create() }
+    {}
+
+    Promise(Promise&& other) noexcept
+        : m_state{ std::exchange(other.m_state, nullptr) }
+        , m_futureRetrieved{ other.m_futureRetrieved }
+        , m_satisfied{ other.m_satisfied }
+    {}
+
+    Promise& operator=(Promise&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_state = std::exchange(other.m_state, nullptr);
+            m_futureRetrieved = other.m_futureRetrieved;
+            m_satisfied = other.m_satisfied;
+        }
+        return *this;
+    }
+
+    ~Promise()
+    {
+        Reset();
+    }
+
+    // Continuations of the future are posted to the executor (run in place by default).
+    Future<T> get_future(const Executor& executor = {})
+    {
+        CheckState();
+        if (m_futureRetrieved)
+            throw std::future_error(std::future_errc::future_already_retrieved);
+
+        m_futureRetrieved = true;
+        m_state->SetExecutor(executor);
+        m_state->AddRef();
+        return Future<T>{ m_state };
+    }
+
+    template <typename... ArgsT>
+    void set_value(ArgsT&&... args)
+    {
+        CheckSatisfied();
+        m_state->SetValue(std::forward<ArgsT>(args)...);
+    }
+
+    void set_exception(std::exception_ptr exception)
+    {
+        CheckSatisfied();
+        m_state->SetException(std::move(exception));
+    }
+
+    bool valid() const
+    {
+        return m_state != nullptr;
+    }
+
+private:
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+
+    void CheckState() const
+    {
+        if (!m_state)
+            throw std::future_error(std::future_errc::no_state);
+    }
+
+    void CheckSatisfied()
+    {
+        CheckState();
+        if (m_satisfied)
+            throw std::future_error(std::future_errc::promise_already_satisfied);
+        m_satisfied = true;
+    }
+
+    void Reset()
+    {
+        if (!m_state)
+            return;
+
+        if (!m_satisfied)
+            m_state->SetException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+
+        std::exchange(m_state, nullptr)->Release();
+    }
+
+    detail::FutureState<T>* m_state;
+    bool m_futureRetrieved{ false };
+    bool m_satisfied{ false };
+};
+
+/** The PackagedTask<FuncT> class is analog of 'std::packaged_task' without type erasure:
+* functional object is stored in place, so the only allocation is (recyclable) shared state.
+*/
+template <typename FuncT>
+class PackagedTask
+{
+public:
+    using ResultType = std::invoke_result_t<FuncT&>;
+
+    template <typename FuncObjT, typename = std::enable_if_t<!std::is_same_v<std::decay_t<FuncObjT>, PackagedTask>>>
+    explicit PackagedTask(FuncObjT&& func)
+        : m_func(std::forward<FuncObjT>(func))
+    {}
+
+    PackagedTask(PackagedTask&&) = default;
+    PackagedTask& operator=(PackagedTask&&) = default;
+
+    auto get_future(const Executor& executor = {})
+    {
+        return m_promise.get_future(executor);
+    }
+
+    void operator()()
+    {
+        detail::SetPromiseResult(m_promise, m_func);
+    }
+
+    // Task which was moved out (e.g. posted to a thread pool) is not valid.
+    bool valid() const
+    {
+        return m_promise.valid();
+    }
+
+    // Completes the future without executing the task (e.g. task is rejected by a thread pool).
+    void set_exception(std::exception_ptr exception)
+    {
+        m_promise.set_exception(std::move(exception));
+    }
+
+private:
+    Promise<ResultType> m_promise;
+    FuncT m_func;
+};
+
+template <typename FuncT>
+auto MakePackagedTask(FuncT&& func)
+{
+    return PackagedTask<std::decay_t<FuncT>>(std::forward<FuncT>(func));
+}
+
+template <typename T>
+struct IsFuture : std::false_type {};
+
+template <typename T>
+struct IsFuture<Future<T>> : std::true_type {};
+
+namespace detail
+{
+    template <typename FutureT, typename... FutureTs>
+    Executor GetFirstExecutor(const FutureT& future, const FutureTs&...)
+    {
+        return FutureAccess::GetState(future)->GetExecutor();
+    }
+
+    inline Executor GetFirstExecutor()
+    {
+        return {};
+    }
+
+    template <typename T, typename FuncT>
+    void ForEachFuture(std::vector<Future<T>>& futures, FuncT&& func)
+    {
+        for (size_t index = 0; index != futures.size(); ++index)
+            func(futures[index], index);
+    }
+
+    template <typename... Ts, typename FuncT>
+    void ForEachFuture(std::tuple<Future<Ts>...>& futures, FuncT&& func)
+    {
+        size_t index = 0;
+        std::apply([&](auto&... future) { (func(future, index++), ...); }, futures);
+    }
+
+    // Combinator futures take ownership of input futures, so continuations can be attached to them.
+    template <typename SequenceT>
+    class WhenAllContext : public std::enable_shared_from_this<WhenAllContext<SequenceT>>
+    {
+    public:
+        explicit WhenAllContext(SequenceT&& futures) : m_futures{ std::move(futures) } {}
+
+        Future<SequenceT> Start(const Executor& executor)
+        {
+            auto result = m_promise.get_future(executor);
+
+            // One extra pending count is kept until all continuations are attached: futures are moved out on completion.
+            ForEachFuture(m_futures, [this](auto& future, size_t) {
+                ++m_pendingCount;
+                FutureAccess::GetState(future)->AddContinuation(MakeCallback([context = this->shared_from_this()] { context->OnReady(); }));
+            });
+            OnReady();
+
+            return result;
+        }
+
+    private:
+        void OnReady()
+        {
+            if (--m_pendingCount == 0)
+                m_promise.set_value(std::move(m_futures));
+        }
+
+        SequenceT           m_futures;
+        std::atomic<size_t> m_pendingCount{ 1 };
+        Promise<SequenceT>  m_promise;
+    };
+
+} // namespace detail
+
+template <typename SequenceT>
+struct WhenAnyResult
+{
+    size_t    index;
+    SequenceT futures;
+};
+
+namespace detail
+{
+    template <typename SequenceT>
+    class WhenAnyContext : public std::enable_shared_from_this<WhenAnyContext<SequenceT>>
+    {
+    public:
+        explicit WhenAnyContext(SequenceT&& futures) : m_futures{ std::move(futures) } {}
+
+        Future<WhenAnyResult<SequenceT>> Start(const Executor& executor)
+        {
+            auto result = m_promise.get_future(executor);
+
+            bool isEmpty = true;
+            ForEachFuture(m_futures, [this, &isEmpty](auto& future, size_t index) {
+                isEmpty = false;
+                FutureAccess::GetState(future)->AddContinuation(MakeCallback([context = this->shared_from_this(), index] { context->OnReady(index); }));
+            });
+
+            // Result is published when there is a winner and all continuations are attached (gate is passed twice).
+            if (isEmpty)
+                m_gate = 1;
+            Open();
+
+            return result;
+        }
+
+    private:
+        void OnReady(size_t index)
+        {
+            if (!m_hasWinner.exchange(true))
+            {
+                m_index = index;
+                Open();
+            }
+        }
+
+        void Open()
+        {
+            if (--m_gate == 0)
+                m_promise.set_value(WhenAnyResult<SequenceT>{ m_index, std::move(m_futures) });
+        }
+
+        SequenceT         m_futures;
+        std::atomic<bool> m_hasWinner{ false };
+        size_t            m_index{ static_cast<size_t>(-1) };
+        std::atomic<int>  m_gate{ 2 };
+        Promise<WhenAnyResult<SequenceT>> m_promise;
+    };
+
+} // namespace detail
+
+/** Returns future which becomes ready when all input futures are ready (analog of 'std::experimental::when_all').
+* Input futures are moved into the result.
+*/
+template <typename... FutureTs>
+auto WhenAll(FutureTs&&... futures)
+{
+    static_assert((IsFuture<std::remove_reference_t<FutureTs>>::value && ...), "WhenAll accepts only futures");
+    static_assert((!std::is_lvalue_reference_v<FutureTs> && ...), "Futures must be passed as rvalues");
+
+    using SequenceType = std::tuple<std::decay_t<FutureTs>...>;
+
+    const auto executor = detail::GetFirstExecutor(futures...);
+    auto context = std::make_shared<detail::WhenAllContext<SequenceType>>(SequenceType{ std::move(futures)... });
+    return context->Start(executor);
+}
+
+template <typename IteratorT, typename = std::enable_if_t<!IsFuture<std::decay_t<IteratorT>>::value>>
+auto WhenAll(IteratorT first, IteratorT last)
+{
+    using SequenceType = std::vector<typename std::iterator_traits<IteratorT>::value_type>;
+
+    SequenceType futures{ std::make_move_iterator(first), std::make_move_iterator(last) };
+    const auto executor = futures.empty() ? Executor{} : detail::GetFirstExecutor(futures.front());
+    auto context = std::make_shared<detail::WhenAllContext<SequenceType>>(std::move(futures));
+    return context->Start(executor);
+}
+
+/** Returns future which becomes ready when any of input futures is ready (analog of 'std::experimental::when_any').
+* Result holds index of the ready future and all input futures.
+*/
+template <typename... FutureTs>
+auto WhenAny(FutureTs&&... futures)
+{
+    static_assert((IsFuture<std::remove_reference_t<FutureTs>>::value && ...), "WhenAny accepts only futures");
+    static_assert((!std::is_lvalue_reference_v<FutureTs> && ...), "Futures must be passed as rvalues");
+
+    using SequenceType = std::tuple<std::decay_t<FutureTs>...>;
+
+    const auto executor = detail::GetFirstExecutor(futures...);
+    auto context = std::make_shared<detail::WhenAnyContext<SequenceType>>(SequenceType{ std::move(futures)... });
+    return context->Start(executor);
+}
+
+template <typename IteratorT, typename = std::enable_if_t<!IsFuture<std::decay_t<IteratorT>>::value>>
+auto WhenAny(IteratorT first, IteratorT last)
+{
+    using SequenceType = std::vector<typename std::iterator_traits<IteratorT>::value_type>;
+
+    SequenceType futures{ std::make_move_iterator(first), std::make_move_iterator(last) };
+    const auto executor = futures.empty() ? Executor{} : detail::GetFirstExecutor(futures.front());
+    auto context = std::make_shared<detail::WhenAnyContext<SequenceType>>(std::move(futures));
+    return context->Start(executor);
+}
@@ -1,55 +1,423 @@
 #pragma once
 
+#include "Cancellation.h"
+#include "Coroutine.h"
+#include "Strand.h"
 #include "TaskQueue.h"
+#include "ThreadPoolOptions.h"
+#include "ThreadPoolStats.h"
+#include "TimerWheel.h"
+#include "WorkerSupervisor.h"
 #include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <thread>
+#include <utility>
+#include <vector>
 
 class MultiQueueThreadPool
 {
 public:
 
     explicit MultiQueueThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()));
+    explicit MultiQueueThreadPool(const ThreadPoolOptions& options);
     ~MultiQueueThreadPool();
 
     template<typename TaskT>
     auto ExecuteAsync(TaskT&& task)
     {
-        const auto index = m_queueIndex++;
-        return m_queues[index % m_queues.size()].Push(std::forward<TaskT>(task));
+        return ExecuteAsync(TaskPriority::Normal, std::forward<TaskT>(task));
     }
 
+    template<typename TaskT>
+    auto ExecuteAsync(TaskPriority priority, TaskT&& task)
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        Post(priority, std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
+
+    // Returns false if the task is rejected (see AdmissionPolicy), rejected task is not consumed.
+    template<typename TaskT>
+    bool Post(TaskT&& task)
+    {
+        return Post(TaskPriority::Normal, std::forward<TaskT>(task));
+    }
+
+    // Queues are not shared between workers, so high priority task goes to the shortest queue.
+    template<typename TaskT>
+    bool Post(TaskPriority priority, TaskT&& task)
+    {
+        for (;;)
+        {
+            auto& queue = m_queues[priority == TaskPriority::High ? SelectShortestQueue() : SelectQueue()];
+            if (queue.Post(priority, std::forward<TaskT>(task)))
+                return true;
+
+            // Queue of a retired worker is closed: the task (not consumed) goes to another one.
+            if (!queue.IsClosed())
+                return false;
+        }
+    }
+
+    template<typename IteratorT>
+    auto ExecuteBatch(IteratorT first, IteratorT last)
+    {
+        auto [jobs, futures] = PackageTasks(first, last, Executor{ *this });
+        PostBatch(std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+        for (auto& job : jobs)
+            detail::RejectIfNotPosted(job);
+        return std::move(futures);
+    }
+
+    // Returns number of posted tasks (rejected ones are left in the range).
+    template<typename IteratorT>
+    size_t PostBatch(IteratorT first, IteratorT last)
+    {
+        // Batch is split into contiguous chunks (one per queue of active workers), so every queue is locked only once.
+        const auto activeCount = m_workers.GetActiveCount();
+        const auto taskCount = static_cast<size_t>(std::distance(first, last));
+        const auto queueCount = std::min(taskCount, activeCount);
+        const auto index = m_queueIndex.fetch_add(queueCount);
+
+        size_t postedCount = 0;
+        for (size_t n = 0; n != queueCount; ++n)
+        {
+            const auto chunkSize = taskCount*(n + 1)/queueCount - taskCount*n/queueCount;
+            const auto chunkLast = std::next(first, chunkSize);
+            auto& queue = m_queues[(index + n) % activeCount];
+
+            auto chunkFirst = first;
+            const auto chunkPostedCount = queue.PostBatch(chunkFirst, chunkLast);
+            postedCount += chunkPostedCount;
+
+            // Worker of the queue has just retired: the rest of the chunk is posted task by task.
+            if (chunkPostedCount != chunkSize && queue.IsClosed())
+            {
+                for (std::advance(chunkFirst, chunkPostedCount); chunkFirst != chunkLast && Post(*chunkFirst); ++chunkFirst)
+                    ++postedCount;
+            }
+
+            first = chunkLast;
+        }
+        return postedCount;
+    }
+
+    /** Tasks with equal keys are executed in order of posting, one at a time, tasks with different keys run in parallel.
+    * Key is hashed to a fixed queue, so its tasks are run by the same worker (its data stays in the cache of one core)
+    * without any locks of their own. Elastic pool moves tasks between queues, so there keys are hashed to strands.
+    * Bounded queue with AdmissionPolicy::CallerRuns may execute a task out of order.
+    */
+    template<typename KeyT, typename TaskT, typename = std::enable_if_t<detail::IsTaskKey<KeyT>>>
+    auto ExecuteAsync(const KeyT& key, TaskT&& task)
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        PostKeyed(std::hash<KeyT>{}(key), std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
+
+    template<typename KeyT, typename TaskT, typename = std::enable_if_t<detail::IsTaskKey<KeyT>>>
+    bool Post(const KeyT& key, TaskT&& task)
+    {
+        return PostKeyed(std::hash<KeyT>{}(key), std::forward<TaskT>(task));
+    }
+
+    // Task is not run if the token is cancelled before a worker takes it: its future gets TaskCancelledError.
+    template<typename TaskT>
+    auto ExecuteAsync(const CancellationToken& token, TaskT&& task)
+    {
+        return ExecuteAsync(detail::MakeCancellableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // As ExecuteAsync with token, cancelled task is dropped. Unlike Post(task), rejected task is consumed.
+    template<typename TaskT>
+    bool Post(const CancellationToken& token, TaskT&& task)
+    {
+        return Post(detail::MakeSkippableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // Task is posted to the pool after the delay (see TimerWheel), the returned id cancels it.
+    template<typename TaskT>
+    TimerId ScheduleAfter(std::chrono::steady_clock::duration delay, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + delay, {}, std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    TimerId ScheduleAt(std::chrono::steady_clock::time_point time, TaskT&& task)
+    {
+        return m_timers.Schedule(time, {}, std::forward<TaskT>(task));
+    }
+
+    // Task is posted every period, the first time after one period.
+    template<typename TaskT>
+    TimerId SchedulePeriodic(std::chrono::steady_clock::duration period, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + period, period, std::forward<TaskT>(task));
+    }
+
+    // Returns false if the timer has already fired or been cancelled.
+    bool CancelTimer(TimerId id)
+    {
+        return m_timers.Cancel(id);
+    }
+
+#ifdef THREAD_POOL_COROUTINES
+    // co_await pool.Schedule() resumes the coroutine on a worker of the pool (see Coroutine.h).
+    ScheduleAwaiter Schedule()
+    {
+        return ScheduleAwaiter{ Executor{ *this } };
+    }
+#endif
+
+    // Current number of workers (it changes with load in elastic pool).
+    size_t GetThreadCount() const
+    {
+        return m_workers.GetActiveCount();
+    }
+
+    // Waits until all posted tasks are done (including tasks posted by them). Must not be called from a task of the pool.
+    void WaitIdle()
+    {
+        m_pending.Wait(m_waitPolicy);
+    }
+
+    // Snapshot of runtime statistics (only pool level counts if THREAD_POOL_STATS is 0).
+    ThreadPoolStats GetStats() const;
+
+    // Stops workers and cancels timers which have not fired, tasks posted after that are rejected. Destructor uses ShutdownMode::Discard.
+    void Shutdown(ShutdownMode mode = ShutdownMode::Drain);
+
 private:
     void Run(size_t queueIndex);
+    size_t SelectQueue();
+    size_t SelectLessLoadedQueue(size_t activeCount) const;
+    size_t SelectShortestQueue() const;
+    static uint64_t GetRandom();
+
+    template<typename TaskT>
+    bool PostKeyed(size_t hash, TaskT&& task)
+    {
+        const auto index = hash % m_queues.size();
+        if (m_workers.IsElastic())
+            return m_keyStrands[index].Post(std::forward<TaskT>(task));
+        return m_queues[index].Post(std::forward<TaskT>(task));
+    }
 
+    detail::TaskCounter    m_pending; // Queued and running tasks of all queues
     std::vector<TaskQueue> m_queues;
     std::atomic<size_t>    m_queueIndex{ 0 };
-    std::vector<std::thread> m_threads;
+    QueueSelection         m_queueSelection;
+    WaitPolicy             m_waitPolicy;
+    detail::WorkerPlacement m_placement;
+    std::vector<detail::WorkerCounters> m_stats;
+    detail::WorkerSupervisor m_workers;
+    std::vector<Strand> m_keyStrands; // Per queue, only in elastic pool
+    TimerWheel m_timers;
+
+    static thread_local MultiQueueThreadPool* t_currentPool;
+    static thread_local size_t                t_currentIndex;
+    static thread_local uint64_t              t_random; // State of GetRandom() of the calling (producer) thread
 };
 
+thread_local MultiQueueThreadPool* MultiQueueThreadPool::t_currentPool{ nullptr };
+thread_local size_t                MultiQueueThreadPool::t_currentIndex{ 0 };
+thread_local uint64_t              MultiQueueThreadPool::t_random{ 0 };
+
 MultiQueueThreadPool::MultiQueueThreadPool(size_t threadCount)
-    : m_queues{ threadCount }
+    : MultiQueueThreadPool(ThreadPoolOptions{ threadCount })
+{}
+
+MultiQueueThreadPool::MultiQueueThreadPool(const ThreadPoolOptions& options)
+    : m_queues{ options.threadCount }
+    , m_queueSelection{ options.queueSelection }
+    , m_waitPolicy{ options.waitPolicy }
+    , m_placement{ options.threadCount, options.affinity }
+    , m_stats(options.threadCount)
+    , m_workers{ options }
+    , m_timers{ Executor{ *this }, options.timerResolution }
 {
-    for (size_t index = 0; index != threadCount; ++index)
-        m_threads.emplace_back([this, index] { Run(index); });
+    for (auto& queue : m_queues)
+    {
+        queue.SetAgingLimit(options.priorityAgingLimit);
+        queue.SetLimits(options.queueLimits);
+        queue.SetTaskCounter(&m_pending);
+        queue.SetOwner(this);
+    }
+
+    if (m_workers.IsElastic())
+    {
+        for (size_t index = 0; index != m_queues.size(); ++index)
+            m_keyStrands.emplace_back(Executor{ *this });
+    }
+
+    m_workers.Start([this](size_t index) { Run(index); }, m_pending, [this](size_t index) { m_queues[index].Open(); });
 }
 
 MultiQueueThreadPool::~MultiQueueThreadPool()
 {
+    Shutdown(ShutdownMode::Discard);
+}
+
+void MultiQueueThreadPool::Shutdown(ShutdownMode mode)
+{
+    m_timers.Stop();
+
+    if (mode == ShutdownMode::Drain)
+        WaitIdle();
+
+    m_workers.Stop();
+
     const bool finishTasks = false;
-    
+
     for (auto& queue : m_queues)
         queue.SetEnabled(finishTasks);
 
-    for (auto& thread : m_threads)
-        thread.join();
+    m_workers.Join();
+
+    for (auto& queue : m_queues)
+        queue.Clear();
+}
+
+ThreadPoolStats MultiQueueThreadPool::GetStats() const
+{
+    auto stats = detail::CollectStats(m_stats);
+    stats.threadCount = m_workers.GetActiveCount();
+    stats.pendingCount = m_pending.GetCount();
+    for (size_t index = 0; index != m_queues.size(); ++index)
+    {
+        stats.workers[index].queueSize = m_queues[index].GetSize();
+        stats.queuedCount += stats.workers[index].queueSize;
+    }
+    return stats;
 }
 
 void MultiQueueThreadPool::Run(size_t queueIndex)
 {
-    while (m_queues[queueIndex].IsEnabled())
+    t_currentPool = this;
+    t_currentIndex = queueIndex;
+    m_placement.Apply(queueIndex);
+
+    auto& stats = m_stats[queueIndex];
+    stats.MakeCurrent();
+
+    auto& queue = m_queues[queueIndex];
+
+    // Queues are not shared, so worker started under load takes half of every backlog (tasks behind busy workers).
+    if (m_workers.IsElastic())
+    {
+        for (size_t index = 0; index != m_workers.GetActiveCount(); ++index)
+        {
+            if (index != queueIndex)
+                queue.TakeTasks(m_queues[index], (m_queues[index].GetSize() + 1)/2);
+        }
+    }
+
+    while (queue.IsEnabled())
+    {
+        TaskQueue::TaskType task;
+        if (queue.WaitAndPop(task, m_waitPolicy, m_workers.GetIdleTimeout()))
+        {
+            const auto startTime = stats.StartTask();
+            task();
+            stats.FinishTask(startTime);
+            m_pending.Done();
+        }
+        else if (m_workers.TryRetire(queueIndex))
+        {
+            // Closed queue rejects new tasks (they are posted to other queues), tasks posted before are executed.
+            queue.Close();
+            while (queue.IsEnabled() && queue.GetSize() != 0)
+            {
+                if (queue.TryPop(task))
+                {
+                    const auto startTime = stats.StartTask();
+                    task();
+                    stats.FinishTask(startTime);
+                    m_pending.Done();
+                }
+            }
+            return;
+        }
+    }
+}
+
+size_t MultiQueueThreadPool::SelectQueue()
+{
+    const auto activeCount = m_workers.GetActiveCount();
+    if (m_queueSelection == QueueSelection::TwoChoices && activeCount > 1)
+        return SelectLessLoadedQueue(activeCount);
+
+    const auto index = m_queueIndex++;
+
+    // Tasks spawned by a worker stay on queues of its NUMA node (if their workers are running).
+    if (t_currentPool == this)
+    {
+        const auto& nodeQueues = m_placement.GetNodeWorkers(t_currentIndex);
+        const auto nodeQueue = nodeQueues[index % nodeQueues.size()];
+        if (nodeQueue < activeCount)
+            return nodeQueue;
+    }
+
+    return index % activeCount;
+}
+
+// Power of two choices: the shorter of two random queues. Producers use own random state instead of the shared counter,
+// queue sizes are read without locks (they are approximate anyway).
+size_t MultiQueueThreadPool::SelectLessLoadedQueue(size_t activeCount) const
+{
+    // Two different positions in [0, count), count > 1.
+    const auto random = GetRandom();
+    const auto selectTwo = [random](size_t count) {
+        const auto first = static_cast<size_t>(random % count);
+        return std::make_pair(first, static_cast<size_t>((first + 1 + (random >> 32) % (count - 1)) % count));
+    };
+
+    auto [first, second] = selectTwo(activeCount);
+
+    // Tasks spawned by a worker stay on queues of its NUMA node (if their workers are running).
+    if (t_currentPool == this)
+    {
+        const auto& nodeQueues = m_placement.GetNodeWorkers(t_currentIndex);
+        if (nodeQueues.size() > 1)
+        {
+            const auto [nodeFirst, nodeSecond] = selectTwo(nodeQueues.size());
+            if (nodeQueues[nodeFirst] < activeCount && nodeQueues[nodeSecond] < activeCount)
+            {
+                first = nodeQueues[nodeFirst];
+                second = nodeQueues[nodeSecond];
+            }
+        }
+    }
+
+    return m_queues[second].GetSize() < m_queues[first].GetSize() ? second : first;
+}
+
+// xorshift64*, state of every thread is seeded by its own address.
+uint64_t MultiQueueThreadPool::GetRandom()
+{
+    if (t_random == 0)
+        t_random = static_cast<uint64_t>(reinterpret_cast<std::uintptr_t>(&t_random)) | 1;
+
+    t_random ^= t_random >> 12;
+    t_random ^= t_random << 25;
+    t_random ^= t_random >> 27;
+    return t_random*0x2545F4914F6CDD1Dull;
+}
+
+size_t MultiQueueThreadPool::SelectShortestQueue() const
+{
+    const auto activeCount = m_workers.GetActiveCount();
+
+    size_t shortest = 0;
+    for (size_t index = 1; index != activeCount; ++index)
     {
-        TaskQueue::TaskPtrType task;
-        if (m_queues[queueIndex].WaitAndPop(task))
-            (*task)();
+        if (m_queues[index].GetSize() < m_queues[shortest].GetSize())
+            shortest = index;
     }
+    return shortest;
 }
@@ -0,0 +1,302 @@
+#pragma once
+
+#include "Future.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/** The IndexIterator<T> / IndexRange<T> classes represent half-open range of integers [first, last),
+* so index loops can be passed to ParallelFor/ParallelReduce the same way as containers (or Zip containers).
+*/
+template <typename IndexT>
+class IndexIterator
+{
+public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = IndexT;
+    using pointer = const IndexT*;
+    using reference = IndexT;
+    using iterator_category = std::random_access_iterator_tag;
+
+    explicit IndexIterator(IndexT index = IndexT{}) : m_index{ index } {}
+
+    IndexT operator*() const { return m_index; }
+
+    IndexIterator& operator++() { ++m_index; return *this; }
+    IndexIterator& operator+=(difference_type n) { m_index = static_cast<IndexT>(m_index + n); return *this; }
+
+    friend difference_type operator-(const IndexIterator& lhs, const IndexIterator& rhs)
+    {
+        return static_cast<difference_type>(lhs.m_index) - static_cast<difference_type>(rhs.m_index);
+    }
+
+    friend bool operator==(const IndexIterator& lhs, const IndexIterator& rhs) { return lhs.m_index == rhs.m_index; }
+    friend bool operator!=(const IndexIterator& lhs, const IndexIterator& rhs) { return lhs.m_index != rhs.m_index; }
+
+private:
+    IndexT m_index;
+};
+
+template <typename IndexT>
+class IndexRange
+{
+    static_assert(std::is_integral_v<IndexT>, "IndexRange supports only integral types");
+
+public:
+    using iterator = IndexIterator<IndexT>;
+
+    IndexRange(IndexT first, IndexT last) : m_first{ first }, m_last{ std::max(first, last) } {}
+
+    iterator begin() const { return iterator{ m_first }; }
+    iterator end() const { return iterator{ m_last }; }
+    size_t size() const { return static_cast<size_t>(m_last - m_first); }
+
+private:
+    IndexT m_first;
+    IndexT m_last;
+};
+
+template <typename IndexT>
+IndexRange<IndexT> MakeIndexRange(IndexT first, IndexT last)
+{
+    return IndexRange<IndexT>{ first, last };
+}
+
+enum class Partitioning
+{
+    Static,  // Range is split into equal chunks, one per participating thread
+    Dynamic, // Threads take chunks of grain size one by one
+    Guided   // Threads take chunks proportional to the remaining work (but not smaller than grain size)
+};
+
+struct ParallelOptions
+{
+    Partitioning partitioning{ Partitioning::Guided };
+    // Minimal number of elements processed by one task, 0 - tuned automatically by measuring first elements.
+    size_t grainSize{ 0 };
+};
+
+namespace detail
+{
+    // Automatic grain size makes every chunk take at least this time, so scheduling cost is negligible.
+    constexpr std::chrono::microseconds ParallelChunkTime{ 50 };
+    constexpr std::chrono::microseconds ParallelProbeTime{ 10 };
+
+    template <typename IteratorT>
+    IteratorT Advance(IteratorT it, size_t count)
+    {
+        // Only operator+= is used: it is the common denominator of random access iterators and ZipIterator.
+        it += static_cast<typename std::iterator_traits<IteratorT>::difference_type>(count);
+        return it;
+    }
+
+    /** Shared state of one parallel loop. Caller is participant 0, helpers posted to the pool are 1..N.
+    * Helpers which start when all chunks are already taken exit immediately, so caller never waits for queued tasks
+    * (it is safe to call parallel algorithms from a task of the same pool).
+    */
+    template <typename IteratorT, typename BodyT>
+    class ParallelLoop
+    {
+    public:
+        ParallelLoop(IteratorT first, size_t size, size_t start, size_t grainSize, size_t participantCount, Partitioning partitioning, BodyT& body)
+            : m_first{ first }
+            , m_size{ size }
+            , m_grainSize{ grainSize }
+            , m_participantCount{ participantCount }
+            , m_partitioning{ partitioning }
+            , m_body{ body }
+            , m_cursor{ start }
+            , m_completedCount{ start }
+        {
+            // Static partitioning: remaining range is split into equal chunks.
+            if (m_partitioning == Partitioning::Static)
+                m_grainSize = std::max(m_grainSize, (size - start + participantCount - 1)/participantCount);
+        }
+
+        Future<void> GetFuture()
+        {
+            return m_done.get_future();
+        }
+
+        void Participate(size_t participant)
+        {
+            size_t chunkFirst = 0;
+            size_t chunkLast = 0;
+            while (TryClaimChunk(chunkFirst, chunkLast))
+            {
+                // After a failure chunks are still claimed and counted (but not executed) to finish the loop.
+                if (!m_hasError.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        m_body(participant, Advance(m_first, chunkFirst), Advance(m_first, chunkLast));
+                    }
+                    catch (...)
+                    {
+                        if (!m_hasError.exchange(true))
+                            m_exception = std::current_exception();
+                    }
+                }
+
+                const auto chunkSize = chunkLast - chunkFirst;
+                if (m_completedCount.fetch_add(chunkSize, std::memory_order_acq_rel) + chunkSize == m_size)
+                    m_done.set_value();
+            }
+        }
+
+        std::exception_ptr GetException() const
+        {
+            return m_exception;
+        }
+
+    private:
+        bool TryClaimChunk(size_t& chunkFirst, size_t& chunkLast)
+        {
+            if (m_partitioning != Partitioning::Guided)
+            {
+                chunkFirst = m_cursor.fetch_add(m_grainSize, std::memory_order_relaxed);
+                if (chunkFirst >= m_size)
+                    return false;
+
+                chunkLast = std::min(m_size, chunkFirst + m_grainSize);
+                return true;
+            }
+
+            chunkFirst = m_cursor.load(std::memory_order_relaxed);
+            do
+            {
+                if (chunkFirst >= m_size)
+                    return false;
+
+                const auto chunkSize = std::max(m_grainSize, (m_size - chunkFirst)/(2*m_participantCount));
+                chunkLast = std::min(m_size, chunkFirst + chunkSize);
+            } while (!m_cursor.compare_exchange_weak(chunkFirst, chunkLast, std::memory_order_relaxed));
+
+            return true;
+        }
+
+        IteratorT           m_first;
+        size_t              m_size;
+        size_t              m_grainSize;
+        size_t              m_participantCount;
+        Partitioning        m_partitioning;
+        BodyT&              m_body;
+        std::atomic<size_t> m_cursor;
+        std::atomic<size_t> m_completedCount;
+        std::atomic<bool>   m_hasError{ false };
+        std::exception_ptr  m_exception;
+        Promise<void>       m_done;
+    };
+
+    /** Runs body(participant, chunkFirst, chunkLast) over the range on the pool and the calling thread,
+    * participant is index in [0, participantCount).
+    * If grain size is not specified, the caller processes first elements alone (1, 2, 4, ...) until it measures
+    * cost of an element: short loops complete without any scheduling, and chunks of long loops are sized to ParallelChunkTime.
+    */
+    template <typename PoolT, typename IteratorT, typename BodyT>
+    void RunParallelLoop(PoolT& pool, IteratorT first, IteratorT last, const ParallelOptions& options, size_t participantCount, BodyT& body)
+    {
+        const auto size = last - first > 0 ? static_cast<size_t>(last - first) : size_t{ 0 };
+
+        size_t start = 0;
+        auto grainSize = options.grainSize;
+        if (grainSize == 0)
+        {
+            using ClockType = std::chrono::steady_clock;
+
+            const auto probeStart = ClockType::now();
+            auto elapsed = ClockType::duration::zero();
+            for (size_t probeSize = 1; start != size && elapsed < ParallelProbeTime; probeSize *= 2)
+            {
+                const auto probeLast = std::min(size, start + probeSize);
+                body(size_t{ 0 }, Advance(first, start), Advance(first, probeLast));
+                start = probeLast;
+                elapsed = ClockType::now() - probeStart;
+            }
+
+            const auto elementTime = std::max<ClockType::duration::rep>(1, elapsed.count()/static_cast<ClockType::duration::rep>(std::max<size_t>(start, 1)));
+            grainSize = std::max<size_t>(1, static_cast<size_t>(std::chrono::duration_cast<ClockType::duration>(ParallelChunkTime).count()/elementTime));
+        }
+
+        if (start == size)
+            return;
+
+        const auto chunkCount = (size - start + grainSize - 1)/grainSize;
+        const auto helperCount = std::min(participantCount - 1, chunkCount - 1);
+        if (helperCount == 0)
+        {
+            body(size_t{ 0 }, Advance(first, start), last);
+            return;
+        }
+
+        auto loop = std::make_shared<ParallelLoop<IteratorT, BodyT>>(first, size, start, grainSize, helperCount + 1, options.partitioning, body);
+        auto done = loop->GetFuture();
+
+        for (size_t helper = 1; helper <= helperCount; ++helper)
+            pool.Post([loop, helper] { loop->Participate(helper); });
+
+        loop->Participate(0);
+        done.wait();
+
+        if (auto exception = loop->GetException())
+            std::rethrow_exception(exception);
+    }
+
+    template <typename T>
+    struct alignas(64) PartialResult
+    {
+        T value;
+    };
+
+} // namespace detail
+
+/** Calls func(element) for every element of the range (container, Zip container or IndexRange) in parallel.
+* Range is processed in chunks by pool threads and by the calling thread, the call returns when all elements are processed.
+* The first exception thrown by func is rethrown (remaining elements may be skipped).
+*/
+template <typename PoolT, typename RangeT, typename FuncT>
+void ParallelFor(PoolT& pool, RangeT&& range, FuncT&& func, const ParallelOptions& options = {})
+{
+    auto body = [&func](size_t, auto first, auto last) {
+        for (; first != last; ++first)
+            func(*first);
+    };
+
+    detail::RunParallelLoop(pool, std::begin(range), std::end(range), options, pool.GetThreadCount() + 1, body);
+}
+
+/** Reduces the range in parallel: every participating thread accumulates partial = reduceOp(partial, element),
+* then partial results are combined by combineOp(result, partial).
+* init is initial value of every partial result, so it must be neutral element of the operation (e.g. 0 for sum),
+* operations must be associative and commutative.
+*/
+template <typename PoolT, typename RangeT, typename T, typename ReduceOpT, typename CombineOpT,
+    typename = std::enable_if_t<!std::is_same_v<std::decay_t<CombineOpT>, ParallelOptions>>>
+T ParallelReduce(PoolT& pool, RangeT&& range, T init, ReduceOpT&& reduceOp, CombineOpT&& combineOp, const ParallelOptions& options = {})
+{
+    const auto participantCount = pool.GetThreadCount() + 1;
+    std::vector<detail::PartialResult<T>> partials(participantCount, detail::PartialResult<T>{ init });
+
+    auto body = [&partials, &reduceOp](size_t participant, auto first, auto last) {
+        auto& partial = partials[participant].value;
+        for (; first != last; ++first)
+            partial = reduceOp(std::move(partial), *first);
+    };
+
+    detail::RunParallelLoop(pool, std::begin(range), std::end(range), options, participantCount, body);
+
+    auto result = std::move(partials.front().value);
+    for (auto partial = std::next(partials.begin()); partial != partials.end(); ++partial)
+        result = combineOp(std::move(result), std::move(partial->value));
+    return result;
+}
+
+template <typename PoolT, typename RangeT, typename T, typename OpT>
+T ParallelReduce(PoolT& pool, RangeT&& range, T init, OpT&& op, const ParallelOptions& options = {})
+{
+    return ParallelReduce(pool, std::forward<RangeT>(range), std::move(init), op, op, options);
+}
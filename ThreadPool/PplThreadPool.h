@@ -1,9 +1,19 @@
 #pragma once
 #ifdef _MSC_VER
+#include "Cancellation.h"
+#include "Coroutine.h"
+#include "Future.h"
+#include "TaskQueue.h"
+#include "ThreadPoolOptions.h"
+#include "ThreadPoolStats.h"
+#include "TimerWheel.h"
 #include <ppltasks.h>
-#include <future>
 #include <ppl.h>
 #include <agents.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 class PplThreadPool
 {
@@ -15,27 +25,173 @@ public:
     template<typename TaskT>
     auto ExecuteAsync(TaskT&& task)
     {
-        using TaskRetType = decltype(task());
-        using PkgTask = std::packaged_task<TaskRetType()>;
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        Post(std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
+
+    // task_group has no priorities: tasks of any priority are scheduled the same way.
+    template<typename TaskT>
+    auto ExecuteAsync(TaskPriority, TaskT&& task)
+    {
+        return ExecuteAsync(std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    bool Post(TaskPriority, TaskT&& task)
+    {
+        return Post(std::forward<TaskT>(task));
+    }
+
+    // task_group is unbounded, so tasks are rejected only after shutdown.
+    // Post in progress is counted, so Shutdown does not wait for the task_group before the task is run by it.
+    template<typename TaskT>
+    bool Post(TaskT&& task)
+    {
+        ++m_postingCount;
+        if (m_stopped)
+        {
+            --m_postingCount;
+            return false;
+        }
 
-        // std::packaged_task<> is move only type.
-        // We need to wrap it in a shared_ptr to use in lambda.
-        auto job =
-            std::make_shared<PkgTask>(std::forward<TaskT>(task));
-        auto future = job->get_future();
+        try
+        {
+            // PPL tasks must be copyable, so task is wrapped in a shared_ptr.
+            auto job = std::make_shared<std::decay_t<TaskT>>(std::forward<TaskT>(task));
+            m_tasks.run([job = std::move(job)] { (*job)(); });
+        }
+        catch (...)
+        {
+            --m_postingCount;
+            throw;
+        }
 
-        m_tasks.run([job = std::move(job)] { (*job)(); });
+        --m_postingCount;
+        return true;
+    }
 
-        return future;
+    template<typename IteratorT>
+    auto ExecuteBatch(IteratorT first, IteratorT last)
+    {
+        std::vector<decltype(ExecuteAsync(*first))> futures;
+        for (; first != last; ++first)
+            futures.push_back(ExecuteAsync(*first));
+        return futures;
     }
 
+    template<typename IteratorT>
+    size_t PostBatch(IteratorT first, IteratorT last)
+    {
+        size_t postedCount = 0;
+        for (; first != last && Post(*first); ++first)
+            ++postedCount;
+        return postedCount;
+    }
+
+    // Task is not run if the token is cancelled before a worker takes it: its future gets TaskCancelledError.
+    template<typename TaskT>
+    auto ExecuteAsync(const CancellationToken& token, TaskT&& task)
+    {
+        return ExecuteAsync(detail::MakeCancellableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // As ExecuteAsync with token, cancelled task is dropped. Unlike Post(task), rejected task is consumed.
+    template<typename TaskT>
+    bool Post(const CancellationToken& token, TaskT&& task)
+    {
+        return Post(detail::MakeSkippableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // Task is posted to the pool after the delay (see TimerWheel), the returned id cancels it.
+    template<typename TaskT>
+    TimerId ScheduleAfter(std::chrono::steady_clock::duration delay, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + delay, {}, std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    TimerId ScheduleAt(std::chrono::steady_clock::time_point time, TaskT&& task)
+    {
+        return m_timers.Schedule(time, {}, std::forward<TaskT>(task));
+    }
+
+    // Task is posted every period, the first time after one period.
+    template<typename TaskT>
+    TimerId SchedulePeriodic(std::chrono::steady_clock::duration period, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + period, period, std::forward<TaskT>(task));
+    }
+
+    // Returns false if the timer has already fired or been cancelled.
+    bool CancelTimer(TimerId id)
+    {
+        return m_timers.Cancel(id);
+    }
+
+#ifdef THREAD_POOL_COROUTINES
+    // co_await pool.Schedule() resumes the coroutine on a worker of the pool (see Coroutine.h).
+    ScheduleAwaiter Schedule()
+    {
+        return ScheduleAwaiter{ Executor{ *this } };
+    }
+#endif
+
+    // Concurrency runtime uses one virtual processor per hardware thread by default.
+    size_t GetThreadCount() const
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Must not be called from a task of the pool.
+    void WaitIdle()
+    {
+        m_tasks.wait();
+    }
+
+    // Workers belong to the Concurrency Runtime, so there are no per-worker statistics.
+    ThreadPoolStats GetStats() const
+    {
+        ThreadPoolStats stats;
+        stats.threadCount = GetThreadCount();
+        return stats;
+    }
+
+    // Cancels timers which have not fired, tasks posted after shutdown are rejected. Destructor drains the pool (task_group has to be waited anyway).
+    void Shutdown(ShutdownMode mode = ShutdownMode::Drain);
+
 private:
 
+    std::atomic<bool> m_stopped{ false };
+    std::atomic<size_t> m_postingCount{ 0 };
     concurrency::task_group m_tasks;
+    TimerWheel m_timers{ Executor{ *this } };
 };
 
 PplThreadPool::~PplThreadPool()
 {
+    Shutdown(ShutdownMode::Drain);
+}
+
+void PplThreadPool::Shutdown(ShutdownMode mode)
+{
+    m_timers.Stop();
+
+    // Queued tasks (and tasks they post) are done before new ones are rejected.
+    if (mode == ShutdownMode::Drain)
+        m_tasks.wait();
+
+    // Posts which have seen the pool running are finished, the rest are rejected: so the last wait sees every task
+    // of the group, and continuations of discarded tasks (broken promises) are run in place instead of the cancelled group.
+    m_stopped = true;
+    while (m_postingCount != 0)
+        std::this_thread::yield();
+
+    if (mode == ShutdownMode::Discard)
+        m_tasks.cancel();
+
     m_tasks.wait();
 }
 #endif
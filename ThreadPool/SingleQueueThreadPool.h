@@ -1,50 +1,217 @@
 #pragma once
 
+#include "Cancellation.h"
+#include "Coroutine.h"
 #include "TaskQueue.h"
+#include "ThreadPoolOptions.h"
+#include "ThreadPoolStats.h"
+#include "TimerWheel.h"
+#include "WorkerSupervisor.h"
 #include <algorithm>
 #include <thread>
+#include <vector>
 
 class SingleQueueThreadPool
 {
 public:
 
     explicit SingleQueueThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()));
+    explicit SingleQueueThreadPool(const ThreadPoolOptions& options);
     ~SingleQueueThreadPool();
 
     template<typename TaskT>
     auto ExecuteAsync(TaskT&& task)
     {
-        return m_queue.Push(std::forward<TaskT>(task));
+        return ExecuteAsync(TaskPriority::Normal, std::forward<TaskT>(task));
     }
 
+    template<typename TaskT>
+    auto ExecuteAsync(TaskPriority priority, TaskT&& task)
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        Post(priority, std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
+
+    // Returns false if the task is rejected (see AdmissionPolicy), rejected task is not consumed.
+    template<typename TaskT>
+    bool Post(TaskT&& task)
+    {
+        return m_queue.Post(std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    bool Post(TaskPriority priority, TaskT&& task)
+    {
+        return m_queue.Post(priority, std::forward<TaskT>(task));
+    }
+
+    template<typename IteratorT>
+    auto ExecuteBatch(IteratorT first, IteratorT last)
+    {
+        auto [jobs, futures] = PackageTasks(first, last, Executor{ *this });
+        PostBatch(std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+        for (auto& job : jobs)
+            detail::RejectIfNotPosted(job);
+        return std::move(futures);
+    }
+
+    // Returns number of posted tasks.
+    template<typename IteratorT>
+    size_t PostBatch(IteratorT first, IteratorT last)
+    {
+        return m_queue.PostBatch(first, last);
+    }
+
+    // Task is not run if the token is cancelled before a worker takes it: its future gets TaskCancelledError.
+    template<typename TaskT>
+    auto ExecuteAsync(const CancellationToken& token, TaskT&& task)
+    {
+        return ExecuteAsync(detail::MakeCancellableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // As ExecuteAsync with token, cancelled task is dropped. Unlike Post(task), rejected task is consumed.
+    template<typename TaskT>
+    bool Post(const CancellationToken& token, TaskT&& task)
+    {
+        return Post(detail::MakeSkippableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // Task is posted to the pool after the delay (see TimerWheel), the returned id cancels it.
+    template<typename TaskT>
+    TimerId ScheduleAfter(std::chrono::steady_clock::duration delay, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + delay, {}, std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    TimerId ScheduleAt(std::chrono::steady_clock::time_point time, TaskT&& task)
+    {
+        return m_timers.Schedule(time, {}, std::forward<TaskT>(task));
+    }
+
+    // Task is posted every period, the first time after one period.
+    template<typename TaskT>
+    TimerId SchedulePeriodic(std::chrono::steady_clock::duration period, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + period, period, std::forward<TaskT>(task));
+    }
+
+    // Returns false if the timer has already fired or been cancelled.
+    bool CancelTimer(TimerId id)
+    {
+        return m_timers.Cancel(id);
+    }
+
+#ifdef THREAD_POOL_COROUTINES
+    // co_await pool.Schedule() resumes the coroutine on a worker of the pool (see Coroutine.h).
+    ScheduleAwaiter Schedule()
+    {
+        return ScheduleAwaiter{ Executor{ *this } };
+    }
+#endif
+
+    // Current number of workers (it changes with load in elastic pool).
+    size_t GetThreadCount() const
+    {
+        return m_workers.GetActiveCount();
+    }
+
+    // Waits until all posted tasks are done (including tasks posted by them). Must not be called from a task of the pool.
+    void WaitIdle()
+    {
+        m_pending.Wait(m_waitPolicy);
+    }
+
+    // Snapshot of runtime statistics (only pool level counts if THREAD_POOL_STATS is 0).
+    ThreadPoolStats GetStats() const;
+
+    // Stops workers and cancels timers which have not fired, tasks posted after that are rejected. Destructor uses ShutdownMode::Discard.
+    void Shutdown(ShutdownMode mode = ShutdownMode::Drain);
+
 private:
-    void Run();
+    void Run(size_t index);
 
+    detail::TaskCounter m_pending; // Queued and running tasks
     TaskQueue m_queue;
-    std::vector<std::thread> m_threads;
+    WaitPolicy m_waitPolicy;
+    detail::WorkerPlacement m_placement;
+    std::vector<detail::WorkerCounters> m_stats;
+    detail::WorkerSupervisor m_workers;
+    TimerWheel m_timers;
 };
 
 SingleQueueThreadPool::SingleQueueThreadPool(size_t threadCount)
+    : SingleQueueThreadPool(ThreadPoolOptions{ threadCount })
+{}
+
+SingleQueueThreadPool::SingleQueueThreadPool(const ThreadPoolOptions& options)
+    : m_waitPolicy{ options.waitPolicy }
+    , m_placement{ options.threadCount, options.affinity }
+    , m_stats(options.threadCount)
+    , m_workers{ options }
+    , m_timers{ Executor{ *this }, options.timerResolution }
 {
-    for (size_t n = 0; n != threadCount; ++n)
-        m_threads.emplace_back([this] { Run(); });
+    m_queue.SetAgingLimit(options.priorityAgingLimit);
+    m_queue.SetLimits(options.queueLimits);
+    m_queue.SetTaskCounter(&m_pending);
+    m_queue.SetOwner(this);
+
+    m_workers.Start([this](size_t index) { Run(index); }, m_pending);
 }
 
 SingleQueueThreadPool::~SingleQueueThreadPool()
 {
+    Shutdown(ShutdownMode::Discard);
+}
+
+void SingleQueueThreadPool::Shutdown(ShutdownMode mode)
+{
+    m_timers.Stop();
+
+    if (mode == ShutdownMode::Drain)
+        WaitIdle();
+
+    m_workers.Stop();
+
     const bool finishTasks = false;
     m_queue.SetEnabled(finishTasks);
 
-    for (auto& thread : m_threads)
-        thread.join();
+    m_workers.Join();
+    m_queue.Clear();
+}
+
+ThreadPoolStats SingleQueueThreadPool::GetStats() const
+{
+    auto stats = detail::CollectStats(m_stats);
+    stats.threadCount = m_workers.GetActiveCount();
+    stats.pendingCount = m_pending.GetCount();
+    stats.queuedCount = m_queue.GetSize();
+    return stats;
 }
 
-void SingleQueueThreadPool::Run()
+void SingleQueueThreadPool::Run(size_t index)
 {
+    m_placement.Apply(index);
+
+    auto& stats = m_stats[index];
+    stats.MakeCurrent();
+
     while (m_queue.IsEnabled())
     {
-        TaskQueue::TaskPtrType task;
-        if (m_queue.WaitAndPop(task))
-            (*task)();
+        TaskQueue::TaskType task;
+        if (m_queue.WaitAndPop(task, m_waitPolicy, m_workers.GetIdleTimeout()))
+        {
+            const auto startTime = stats.StartTask();
+            task();
+            stats.FinishTask(startTime);
+            m_pending.Done();
+        }
+        else if (m_workers.TryRetire(index))
+        {
+            return;
+        }
     }
 }
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Cancellation.h"
+#include "Future.h"
+#include "TaskQueue.h"
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace detail
+{
+    // Anything hashable except priorities and tokens (they have own overloads) may be the key of keyed tasks.
+    template <typename KeyT>
+    constexpr bool IsTaskKey = !std::is_same_v<std::decay_t<KeyT>, TaskPriority> && !std::is_same_v<std::decay_t<KeyT>, CancellationToken>;
+
+    class StrandState : public std::enable_shared_from_this<StrandState>
+    {
+    public:
+        // Tasks are run in batches of this size, then the strand is posted again, so it does not hold a worker for long.
+        static constexpr size_t BatchSize = 64;
+
+        explicit StrandState(const Executor& executor) : m_executor{ executor } {}
+
+        const Executor& GetExecutor() const
+        {
+            return m_executor;
+        }
+
+        void Post(Callback&& task)
+        {
+            {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                m_tasks.Push(std::move(task));
+                if (m_isScheduled)
+                    return;
+                m_isScheduled = true;
+            }
+            Schedule();
+        }
+
+    private:
+        void Schedule()
+        {
+            m_executor.Post([self = shared_from_this()] { self->Run(); });
+        }
+
+        void Run()
+        {
+            for (size_t n = 0; n != BatchSize; ++n)
+            {
+                Callback task;
+                {
+                    std::lock_guard<std::mutex> lock{ m_mutex };
+                    if (m_tasks.empty())
+                    {
+                        m_isScheduled = false;
+                        return;
+                    }
+                    task = m_tasks.Pop();
+                }
+                task();
+            }
+            Schedule();
+        }
+
+        Executor             m_executor;
+        std::mutex           m_mutex;
+        RingBuffer<Callback> m_tasks;
+        bool                 m_isScheduled{ false }; // Run is posted to the executor or is running
+    };
+
+} // namespace detail
+
+/** The Strand class is serial executor on top of a thread pool (like strand of boost::asio): tasks posted to the strand
+* are executed one at a time in order of posting, so data used only by them needs no mutex.
+* - Strand is not bound to a worker: while it has tasks, it is posted to the pool as one task, which runs
+*   them in batches, so it migrates between workers and different strands run in parallel.
+* - Copies refer to the same strand. Pool must outlive strand tasks, tasks discarded by the pool on shutdown are dropped.
+*/
+class Strand
+{
+public:
+    template <typename PoolT, typename = std::enable_if_t<!std::is_same_v<std::decay_t<PoolT>, Strand> && !std::is_same_v<std::decay_t<PoolT>, Executor>>>
+    explicit Strand(PoolT& pool)
+        : Strand(Executor{ pool })
+    {}
+
+    explicit Strand(const Executor& executor)
+        : m_state{ std::make_shared<detail::StrandState>(executor) }
+    {}
+
+    // Continuations of the future are posted to the pool of the strand.
+    template <typename TaskT>
+    auto ExecuteAsync(TaskT&& task)
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(m_state->GetExecutor());
+        Post(std::move(job));
+        return future;
+    }
+
+    // Task is never rejected: if the pool rejects the strand, its tasks are executed in place (see Executor).
+    template <typename TaskT>
+    bool Post(TaskT&& task)
+    {
+        m_state->Post(detail::MakeCallback(std::forward<TaskT>(task)));
+        return true;
+    }
+
+private:
+    std::shared_ptr<detail::StrandState> m_state;
+};
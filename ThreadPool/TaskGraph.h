@@ -0,0 +1,256 @@
+#pragma once
+
+#include "Future.h"
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+/** The TaskGraph class implements reusable DAG of tasks executed on a thread pool.
+* - Nodes (void() callables owned by the graph) and edges are declared once, graph can be run many times.
+* - Finalize() packs edges into compact adjacency arrays and computes critical path (longest path to a sink) of every node.
+* - Run tracks dependency counter per node: node is scheduled when all its predecessors are done.
+* - Ready nodes are scheduled critical-path-first: the most critical successor is executed in place, others are posted.
+* - If a node throws, remaining nodes are skipped and exception is reported by the future returned from RunAsync().
+* Graph must not be modified while it runs, and only one run at a time is allowed.
+*/
+class TaskGraph
+{
+public:
+    using NodeId = size_t;
+
+    TaskGraph() = default;
+
+    template <typename FuncT>
+    NodeId AddNode(FuncT&& func)
+    {
+        CheckNotRunning();
+        m_nodes.push_back(detail::MakeCallback(std::forward<FuncT>(func)));
+        m_isFinalized = false;
+        return m_nodes.size() - 1;
+    }
+
+    template <typename FuncT>
+    NodeId AddNode(FuncT&& func, std::initializer_list<NodeId> dependencies)
+    {
+        const auto node = AddNode(std::forward<FuncT>(func));
+        for (const auto dependency : dependencies)
+            AddEdge(dependency, node);
+        return node;
+    }
+
+    // Node 'to' is executed after node 'from' is done.
+    void AddEdge(NodeId from, NodeId to);
+
+    // Is called by the first run, graph changes after that are detected.
+    void Finalize();
+
+    template <typename PoolT>
+    Future<void> RunAsync(PoolT& pool)
+    {
+        return Start(Executor{ pool });
+    }
+
+    template <typename PoolT>
+    void Run(PoolT& pool)
+    {
+        RunAsync(pool).get();
+    }
+
+    size_t GetNodeCount() const
+    {
+        return m_nodes.size();
+    }
+
+private:
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    static constexpr NodeId NoNode = static_cast<NodeId>(-1);
+
+    void CheckNotRunning() const;
+    Future<void> Start(const Executor& executor);
+    void Execute(NodeId node);
+    void Complete();
+
+    std::vector<detail::Callback>          m_nodes;
+    std::vector<std::pair<NodeId, NodeId>> m_edges;
+
+    // Built by Finalize(): successors of node n are m_successors[m_offsets[n]..m_offsets[n + 1]),
+    // sorted by critical path length (as well as roots).
+    bool                m_isFinalized{ false };
+    std::vector<size_t> m_offsets;
+    std::vector<NodeId> m_successors;
+    std::vector<size_t> m_dependencyCounts;
+    std::vector<NodeId> m_roots;
+
+    // State of the current run.
+    std::unique_ptr<std::atomic<size_t>[]> m_pendingCounts;
+    std::atomic<size_t> m_remainingCount{ 0 };
+    std::atomic<bool>   m_isRunning{ false };
+    std::atomic<bool>   m_hasError{ false };
+    std::exception_ptr  m_exception;
+    Executor            m_executor;
+    Promise<void>       m_promise;
+};
+
+void TaskGraph::AddEdge(NodeId from, NodeId to)
+{
+    CheckNotRunning();
+    if (from >= m_nodes.size() || to >= m_nodes.size())
+        throw std::out_of_range{ "TaskGraph: node does not exist" };
+    if (from == to)
+        throw std::invalid_argument{ "TaskGraph: node cannot depend on itself" };
+
+    m_edges.emplace_back(from, to);
+    m_isFinalized = false;
+}
+
+void TaskGraph::Finalize()
+{
+    CheckNotRunning();
+    const auto nodeCount = m_nodes.size();
+
+    m_offsets.assign(nodeCount + 1, 0);
+    m_dependencyCounts.assign(nodeCount, 0);
+    for (const auto& [from, to] : m_edges)
+    {
+        ++m_offsets[from + 1];
+        ++m_dependencyCounts[to];
+    }
+    std::partial_sum(m_offsets.begin(), m_offsets.end(), m_offsets.begin());
+
+    m_successors.resize(m_edges.size());
+    std::vector<size_t> positions{ m_offsets.begin(), m_offsets.end() - 1 };
+    for (const auto& [from, to] : m_edges)
+        m_successors[positions[from]++] = to;
+
+    // Topological order (Kahn's algorithm), it also detects cycles.
+    std::vector<NodeId> order;
+    order.reserve(nodeCount);
+    auto counts = m_dependencyCounts;
+    for (NodeId node = 0; node != nodeCount; ++node)
+    {
+        if (counts[node] == 0)
+            order.push_back(node);
+    }
+    for (size_t n = 0; n != order.size(); ++n)
+    {
+        for (auto edge = m_offsets[order[n]]; edge != m_offsets[order[n] + 1]; ++edge)
+        {
+            if (--counts[m_successors[edge]] == 0)
+                order.push_back(m_successors[edge]);
+        }
+    }
+    if (order.size() != nodeCount)
+        throw std::logic_error{ "TaskGraph: graph contains a cycle" };
+
+    // Critical path: number of nodes on the longest path from the node to a sink.
+    std::vector<size_t> criticalPaths(nodeCount, 1);
+    for (auto node = order.rbegin(); node != order.rend(); ++node)
+    {
+        for (auto edge = m_offsets[*node]; edge != m_offsets[*node + 1]; ++edge)
+            criticalPaths[*node] = std::max(criticalPaths[*node], criticalPaths[m_successors[edge]] + 1);
+    }
+
+    const auto isMoreCritical = [&criticalPaths](NodeId lhs, NodeId rhs) { return criticalPaths[lhs] > criticalPaths[rhs]; };
+    for (NodeId node = 0; node != nodeCount; ++node)
+        std::stable_sort(m_successors.begin() + m_offsets[node], m_successors.begin() + m_offsets[node + 1], isMoreCritical);
+
+    m_roots.clear();
+    std::copy_if(order.begin(), order.end(), std::back_inserter(m_roots), [this](NodeId node) { return m_dependencyCounts[node] == 0; });
+    std::stable_sort(m_roots.begin(), m_roots.end(), isMoreCritical);
+
+    m_pendingCounts = std::make_unique<std::atomic<size_t>[]>(nodeCount);
+    m_isFinalized = true;
+}
+
+void TaskGraph::CheckNotRunning() const
+{
+    if (m_isRunning)
+        throw std::logic_error{ "TaskGraph: graph is running" };
+}
+
+Future<void> TaskGraph::Start(const Executor& executor)
+{
+    if (!m_isFinalized)
+        Finalize();
+
+    if (m_isRunning.exchange(true))
+        throw std::logic_error{ "TaskGraph: graph is running" };
+
+    m_executor = executor;
+    m_promise = Promise<void>{};
+    auto future = m_promise.get_future(executor);
+
+    if (m_nodes.empty())
+    {
+        Complete();
+        return future;
+    }
+
+    m_hasError = false;
+    m_remainingCount = m_nodes.size();
+    for (NodeId node = 0; node != m_nodes.size(); ++node)
+        m_pendingCounts[node].store(m_dependencyCounts[node], std::memory_order_relaxed);
+
+    for (const auto root : m_roots)
+        m_executor.Post([this, root] { Execute(root); });
+
+    return future;
+}
+
+void TaskGraph::Execute(NodeId node)
+{
+    while (node != NoNode)
+    {
+        if (!m_hasError.load(std::memory_order_relaxed))
+        {
+            try
+            {
+                m_nodes[node]();
+            }
+            catch (...)
+            {
+                if (!m_hasError.exchange(true))
+                    m_exception = std::current_exception();
+            }
+        }
+
+        // The most critical ready successor continues on this thread: no scheduling cost for chains.
+        auto next = NoNode;
+        for (auto edge = m_offsets[node]; edge != m_offsets[node + 1]; ++edge)
+        {
+            const auto successor = m_successors[edge];
+            if (m_pendingCounts[successor].fetch_sub(1, std::memory_order_acq_rel) != 1)
+                continue;
+
+            if (next == NoNode)
+                next = successor;
+            else
+                m_executor.Post([this, successor] { Execute(successor); });
+        }
+
+        if (m_remainingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            Complete();
+
+        node = next;
+    }
+}
+
+void TaskGraph::Complete()
+{
+    // Graph may be destroyed or restarted as soon as the promise is satisfied, so members are not touched after that.
+    auto promise = std::move(m_promise);
+    auto exception = std::exchange(m_exception, nullptr);
+    m_isRunning = false;
+
+    if (exception)
+        promise.set_exception(std::move(exception));
+    else
+        promise.set_value();
+}
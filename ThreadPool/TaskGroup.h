@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Future.h"
+#include "Common/SpinWait.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+
+namespace detail
+{
+    /** Counter of outstanding tasks with waiting for zero.
+    * Waiter spins (see WaitPolicy) and then parks, Done() takes the lock only for the last tasks: waiter which saw zero
+    * takes the lock before return, so counter may be destroyed right after Wait() (Done() is not using it anymore).
+    */
+    class TaskCounter
+    {
+    public:
+        void Add(size_t count = 1)
+        {
+            m_count.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        void Done(size_t count = 1)
+        {
+            auto current = m_count.load();
+            while (current != count)
+            {
+                if (m_count.compare_exchange_weak(current, current - count))
+                    return;
+            }
+
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            if (m_count.fetch_sub(count) == count && m_waitingCount != 0)
+                m_idle.notify_all();
+        }
+
+        void Wait(const WaitPolicy& policy = {})
+        {
+            SpinWait spinWait{ policy };
+            while (m_count.load() != 0)
+            {
+                if (spinWait.SpinOnce())
+                    continue;
+
+                std::unique_lock<std::mutex> lock{ m_mutex };
+                ++m_waitingCount;
+                m_idle.wait(lock, [this] { return m_count.load() == 0; });
+                --m_waitingCount;
+            }
+
+            // Zero may be seen while Done() which made it still holds the lock.
+            std::lock_guard<std::mutex> lock{ m_mutex };
+        }
+
+        size_t GetCount() const
+        {
+            return m_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<size_t>     m_count{ 0 };
+        size_t                  m_waitingCount{ 0 }; // Parked waiters, guarded by the mutex
+        std::mutex              m_mutex;
+        std::condition_variable m_idle;
+    };
+
+} // namespace detail
+
+/** The TaskGroup class tracks completion of fire-and-forget tasks posted to any thread pool by one atomic counter,
+* so a batch of tasks can be joined without a future per task.
+* The first exception thrown by a task is rethrown by Wait(). Destructor waits for the tasks.
+* Wait() must not be called from a task of the group (like Future::wait, it blocks the worker).
+*/
+class TaskGroup
+{
+public:
+    TaskGroup() = default;
+
+    ~TaskGroup()
+    {
+        m_counter.Wait();
+    }
+
+    // Task rejected by the pool (e.g. bounded queue is full) is executed in place.
+    template <typename PoolT, typename TaskT>
+    void Run(PoolT& pool, TaskT&& task)
+    {
+        m_counter.Add();
+        Executor{ pool }.Post([this, task = std::decay_t<TaskT>(std::forward<TaskT>(task))]() mutable {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                if (!m_hasError.exchange(true))
+                    m_exception = std::current_exception();
+            }
+            m_counter.Done();
+        });
+    }
+
+    void Wait(const WaitPolicy& policy = {})
+    {
+        m_counter.Wait(policy);
+
+        if (m_hasError.load())
+        {
+            m_hasError = false;
+            std::rethrow_exception(std::exchange(m_exception, nullptr));
+        }
+    }
+
+    size_t GetPendingCount() const
+    {
+        return m_counter.GetCount();
+    }
+
+private:
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    detail::TaskCounter m_counter;
+    std::atomic<bool>   m_hasError{ false };
+    std::exception_ptr  m_exception;
+};
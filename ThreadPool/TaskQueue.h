@@ -1,10 +1,24 @@
 #pragma once
 
+#include "Future.h"
+#include "TaskGroup.h"
+#include "ThreadPoolStats.h"
+#include "Common/FixedFunction.h"
+#include "Common/SpinWait.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <condition_variable>
 #include <optional>
 #include <functional>
-#include <future>
-#include <queue>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 class TaskBase
 {
@@ -14,19 +28,149 @@ public:
     void operator()() { exec(); }
 };
 
-template <typename T> 
+template <typename T>
 class Task : public TaskBase
 {
 public:
-    Task(T&& t) : task(std::move(t)) {}
+    template <typename U>
+    explicit Task(U&& t) : task(std::forward<U>(t)) {}
     void exec() override { task(); }
 
     T task;
 };
 
+/** The RingBuffer<T> class implements FIFO queue on top of circular buffer.
+* Buffer grows twice when it is full and never shrinks, so in steady state Push/Pop do not allocate.
+* Popped slots are reused in-place (move assignment), thus T must be default constructible and movable.
+*/
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(size_t capacity = 64) : m_items(std::max<size_t>(capacity, 1)) {}
+
+    void Push(T&& item)
+    {
+        if (m_size == m_items.size())
+            Grow();
+
+        m_items[(m_head + m_size) % m_items.size()] = std::move(item);
+        ++m_size;
+    }
+
+    T Pop()
+    {
+        T item{ std::move(m_items[m_head]) };
+        m_head = (m_head + 1) % m_items.size();
+        --m_size;
+        return item;
+    }
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+
+private:
+    void Grow()
+    {
+        std::vector<T> items(m_items.size() * 2);
+        for (size_t n = 0; n != m_size; ++n)
+            items[n] = std::move(m_items[(m_head + n) % m_items.size()]);
+
+        m_items = std::move(items);
+        m_head = 0;
+    }
+
+    std::vector<T> m_items;
+    size_t m_head{ 0 };
+    size_t m_size{ 0 };
+};
+
+/** Wraps every task of the range into PackagedTask.
+* Returns pair of packaged tasks and their futures (in the same order as tasks in the range).
+* Continuations of the futures are posted to the executor.
+*/
+template <typename IteratorT>
+auto PackageTasks(IteratorT first, IteratorT last, const Executor& executor = {})
+{
+    using PkgTask = decltype(MakePackagedTask(*first));
+
+    std::vector<PkgTask> jobs;
+    std::vector<decltype(jobs.back().get_future())> futures;
+    for (; first != last; ++first)
+    {
+        jobs.push_back(MakePackagedTask(*first));
+        futures.push_back(jobs.back().get_future(executor));
+    }
+
+    return std::make_pair(std::move(jobs), std::move(futures));
+}
+
+/** Is stored in futures of tasks which were not accepted by a thread pool
+* (bounded queue is full and AdmissionPolicy::Try is used, or the pool is being destroyed).
+*/
+class TaskRejectedError : public std::runtime_error
+{
+public:
+    TaskRejectedError() : std::runtime_error{ "Task is rejected by thread pool" } {}
+};
+
+namespace detail
+{
+    // Task (PackagedTask) which was not consumed by Post is completed with TaskRejectedError.
+    template <typename JobT>
+    void RejectIfNotPosted(JobT& job)
+    {
+        if (job.valid())
+            job.set_exception(std::make_exception_ptr(TaskRejectedError{}));
+    }
+
+} // namespace detail
+
+// What happens with a task posted to a full bounded queue.
+enum class AdmissionPolicy
+{
+    Block,     // Caller waits for free space (workers of the pool never block: they run the task themselves)
+    Try,       // Task is rejected: Post returns false, future of ExecuteAsync gets TaskRejectedError
+    CallerRuns // Task is executed by the caller
+};
+
+struct TaskQueueLimits
+{
+    size_t capacity{ 0 }; // 0 - unbounded
+    AdmissionPolicy admission{ AdmissionPolicy::Block };
+
+    // onHighWatermark is called (by producer) when queue size reaches highWatermark, then onLowWatermark is called
+    // (by consumer) when it drops to lowWatermark. Callbacks are called outside of the queue lock, 0 - disabled.
+    size_t highWatermark{ 0 };
+    size_t lowWatermark{ 0 };
+    std::function<void()> onHighWatermark;
+    std::function<void()> onLowWatermark;
+};
+
+// Tasks of higher priority (smaller value) are popped first.
+enum class TaskPriority : unsigned
+{
+    High,
+    Normal,
+    Low
+};
+
+constexpr size_t TaskPriorityCount = 3;
+
+/** The TaskQueue class is a multi-level FIFO queue: one ring buffer per priority level
+* and a bitmap of non-empty levels, so the highest non-empty level is found in O(1).
+* Aging prevents starvation: after agingLimit pops of higher priority tasks (while lower ones are waiting)
+* a task of the lowest waiting priority is popped.
+* Queue may be bounded (see TaskQueueLimits): full queue pushes back on producers according to the admission policy,
+* a rejected task is not consumed, so caller still owns it.
+*/
 class TaskQueue
 {
 public:
+    // Tasks which fit into storage are kept inline in queue slots (no heap allocation),
+    // bigger ones are moved to the heap and only their pointer is kept in the slot.
+    static constexpr size_t TaskStorageSize = 64;
+    using TaskType = FixedFunction<void(), TaskStorageSize>;
     using TaskPtrType = std::unique_ptr<TaskBase>;
 
     TaskQueue() = default;
@@ -35,6 +179,36 @@ public:
     TaskQueue(TaskQueue &&) = default;
     TaskQueue &operator=(TaskQueue &&) = default;
 
+    // Task is stamped with submission time for queue latency statistics (unless it is TaskType already).
+    template <typename FuncT>
+    static TaskType MakeTask(FuncT&& func)
+    {
+        if constexpr (detail::StatsEnabled && !std::is_same_v<std::decay_t<FuncT>, TaskType>)
+            return WrapTask(detail::StampTask(std::forward<FuncT>(func)));
+        else
+            return WrapTask(std::forward<FuncT>(func));
+    }
+
+    template <typename FuncT>
+    static TaskType WrapTask(FuncT&& func)
+    {
+        using FuncType = std::decay_t<FuncT>;
+
+        if constexpr (std::is_same_v<FuncType, TaskType>)
+        {
+            return std::forward<FuncT>(func);
+        }
+        else if constexpr (sizeof(FuncType) < TaskStorageSize && alignof(FuncType) <= alignof(size_t))
+        {
+            return TaskType{ [func = FuncType(std::forward<FuncT>(func))]() mutable { func(); } };
+        }
+        else
+        {
+            auto task = std::make_unique<Task<FuncType>>(std::forward<FuncT>(func));
+            return TaskType{ [task = std::move(task)] { (*task)(); } };
+        }
+    }
+
     void SetEnabled(bool enabled)
     {
         {
@@ -43,87 +217,520 @@ public:
         }
 
         if (!enabled)
+        {
             m_ready.notify_all();
+            m_notFull.notify_all();
+        }
     }
 
-    auto IsEnabled() const 
+    auto IsEnabled() const
     {
         LockType lock{ m_mutex };
         return m_enabled;
     }
 
-    auto WaitAndPop(TaskPtrType &task) 
+    // 0 - strict priorities (no aging).
+    void SetAgingLimit(size_t agingLimit)
+    {
+        LockType lock{ m_mutex };
+        m_agingLimit = agingLimit;
+    }
+
+    // Closed queue rejects new tasks (like disabled one), but queued tasks can still be popped.
+    void Close()
+    {
+        {
+            LockType lock{ m_mutex };
+            m_isClosed = true;
+        }
+        m_notFull.notify_all();
+    }
+
+    void Open()
+    {
+        LockType lock{ m_mutex };
+        m_isClosed = false;
+    }
+
+    // Closed but not disabled (i.e. task rejected by the queue may be posted to another one).
+    bool IsClosed() const
+    {
+        LockType lock{ m_mutex };
+        return m_enabled && m_isClosed;
+    }
+
+    // Should be set before the queue is used.
+    void SetLimits(const TaskQueueLimits& limits)
+    {
+        LockType lock{ m_mutex };
+        m_limits = limits;
+    }
+
+    // Queues of one pool share the owner: worker popping from any of them does not block on full ones (see AdmissionPolicy::Block).
+    // Queue which has no owner is owned by itself. Should be set before the queue is used.
+    void SetOwner(const void* owner)
+    {
+        LockType lock{ m_mutex };
+        m_owner = owner;
+    }
+
+    // Counter is incremented for every queued task (and decremented for dropped ones),
+    // consumer decrements it when popped task is done. Several queues may share one counter.
+    void SetTaskCounter(detail::TaskCounter* counter)
     {
         LockType lock{ m_mutex };
-        m_ready.wait(lock, [this] { return !m_enabled || !m_queue.empty(); });
-        if (m_enabled && !m_queue.empty()) {
-            task = std::move(m_queue.front());
-            m_queue.pop();
+        m_counter = counter;
+    }
+
+    // Lock free (approximate) checks, e.g. for thieves looking for high priority work.
+    bool HasTasks(TaskPriority priority) const
+    {
+        return (m_levels.load(std::memory_order_relaxed) & LevelBit(priority)) != 0;
+    }
+
+    size_t GetSize() const
+    {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    auto WaitAndPop(TaskType &task, const WaitPolicy& policy = {})
+    {
+        return WaitAndPop(task, policy, std::chrono::steady_clock::duration::max());
+    }
+
+    // Spins (lock free check of queue size) according to the policy before parking on condition variable,
+    // so short bursts of tasks are picked up without context switches.
+    // Returns false if the queue is disabled or there was no task for timeout.
+    bool WaitAndPop(TaskType &task, const WaitPolicy& policy, std::chrono::steady_clock::duration timeout)
+    {
+        SpinWait spinWait{ policy };
+        while (m_size.load(std::memory_order_relaxed) == 0 && spinWait.SpinOnce())
+        {
+        }
+
+        t_consumedOwner = GetOwner();
+
+        LockType lock{ m_mutex };
+        const auto isReady = [this] { return !m_enabled || m_levels != 0; };
+        const auto parkStartTime = isReady() ? detail::StatsClock::time_point{} : detail::WorkerCounters::StartPark();
+        ++m_waitingCount;
+        if (timeout == std::chrono::steady_clock::duration::max())
+            m_ready.wait(lock, isReady);
+        else
+            m_ready.wait_for(lock, timeout, isReady);
+        --m_waitingCount;
+        detail::WorkerCounters::FinishPark(parkStartTime);
+        if (m_enabled && m_levels != 0) {
+            task = PopLocked();
+            OnPopped(lock);
+            detail::Trace(TaskTrace::EventType::Dequeue);
             return true;
         }
         return false;
     }
 
     template <typename TaskT>
-    auto Push(TaskT &&task) // -> std::future<decltype(task())>
+    auto Push(TaskT &&task) // -> Future<decltype(task())>
     {
-        using TaskRetType = decltype(task());
-        using PkgTask = std::packaged_task<TaskRetType()>;
-        auto job = 
-            std::make_unique<Task<PkgTask>>(PkgTask(std::forward<TaskT>(task)));
-        auto future = job->task.get_future();
+        return Push(TaskPriority::Normal, std::forward<TaskT>(task));
+    }
+
+    template <typename TaskT>
+    auto Push(TaskPriority priority, TaskT &&task) // -> Future<decltype(task())>
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future();
+        Post(priority, std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
+
+    template <typename TaskT>
+    bool Post(TaskT &&task)
+    {
+        return Post(TaskPriority::Normal, std::forward<TaskT>(task));
+    }
 
+    // Fire-and-forget: no result channel, no shared state.
+    // Returns false if the task is rejected (queue is disabled, or full with AdmissionPolicy::Try).
+    // Notification (system call) is skipped if there is no parked worker.
+    template <typename TaskT>
+    bool Post(TaskPriority priority, TaskT &&task)
+    {
+        size_t waitingCount = 0;
+        bool isHighWatermark = false;
         {
             LockType lock{ m_mutex };
-            m_queue.emplace(std::move(job));
+            switch (Admit(lock))
+            {
+            case Admission::Rejected:
+                return false;
+            case Admission::CallerRuns:
+                lock.unlock();
+                MakeTask(std::forward<TaskT>(task))(); // Consumed as accepted task
+                return true;
+            case Admission::Accepted:
+                break;
+            }
+
+            PushLocked(priority, MakeTask(std::forward<TaskT>(task)));
+            waitingCount = m_waitingCount;
+            isHighWatermark = IsHighWatermarkReached();
         }
 
-        m_ready.notify_one();
-        return future;
+        if (waitingCount != 0)
+            m_ready.notify_one();
+        if (isHighWatermark)
+            m_limits.onHighWatermark();
+        return true;
     }
 
-    auto TryPop(TaskPtrType &task) 
+    // Takes the lock once for the whole range and wakes only as many waiting workers as there are new tasks.
+    // Returns number of accepted tasks: bounded queue accepts tasks one by one and stops at the first rejected one.
+    template <typename IteratorT>
+    size_t PostBatch(IteratorT first, IteratorT last)
     {
+        if (m_limits.capacity != 0)
+        {
+            size_t postedCount = 0;
+            for (; first != last && Post(TaskPriority::Normal, *first); ++first)
+                ++postedCount;
+            return postedCount;
+        }
+
+        size_t taskCount = 0;
+        size_t waitingCount = 0;
+        bool isHighWatermark = false;
+        {
+            LockType lock{ m_mutex };
+            if (!m_enabled || m_isClosed)
+                return 0;
+
+            for (; first != last; ++first, ++taskCount)
+                PushLocked(TaskPriority::Normal, MakeTask(*first));
+
+            waitingCount = m_waitingCount;
+            isHighWatermark = IsHighWatermarkReached();
+        }
+
+        if (isHighWatermark)
+            m_limits.onHighWatermark();
+
+        auto wakeCount = std::min(taskCount, waitingCount);
+        if (wakeCount == 0)
+            return taskCount;
+
+        if (wakeCount == waitingCount)
+            m_ready.notify_all();
+        else
+            while (wakeCount-- != 0)
+                m_ready.notify_one();
+        return taskCount;
+    }
+
+    template <typename IteratorT>
+    auto PushBatch(IteratorT first, IteratorT last) // -> std::vector<Future<decltype((*first)())>>
+    {
+        auto [jobs, futures] = PackageTasks(first, last);
+        PostBatch(std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+        for (auto& job : jobs)
+            detail::RejectIfNotPosted(job);
+        return std::move(futures);
+    }
+
+    auto TryPop(TaskType &task)
+    {
+        t_consumedOwner = GetOwner();
+
         LockType lock{ m_mutex, std::try_to_lock };
 
-        if (!lock || !m_enabled || m_queue.empty())
+        if (!lock || !m_enabled || m_levels == 0)
             return false;
 
-        task = std::move(m_queue.front());
-        m_queue.pop();
+        task = PopLocked();
+        OnPopped(lock);
+        detail::Trace(TaskTrace::EventType::Dequeue);
         return true;
     }
 
     template <typename TaskT>
-    auto TryPush(TaskT &&task) // -> std::optional<std::future<decltype(task())>>
+    auto TryPush(TaskT &&task) // -> std::optional<Future<decltype(task())>>
     {
         using TaskRetType = decltype(task());
 
-        std::optional<std::future<TaskRetType>> future;
+        std::optional<Future<TaskRetType>> future;
+        size_t waitingCount = 0;
+        bool isHighWatermark = false;
         {
             LockType lock{ m_mutex, std::try_to_lock };
-            if (!lock)
+            if (!lock || !m_enabled || m_isClosed || IsFull())
                 return future;
 
-            using PkgTask = std::packaged_task<TaskRetType()>;
-            auto job =
-                std::make_unique<Task<PkgTask>>(PkgTask(std::forward<TaskT>(task)));
-            future = job->task.get_future();
-            m_queue.emplace(std::move(job));
+            auto job = MakePackagedTask(std::forward<TaskT>(task));
+            future = job.get_future();
+            PushLocked(TaskPriority::Normal, MakeTask(std::move(job)));
+            waitingCount = m_waitingCount;
+            isHighWatermark = IsHighWatermarkReached();
         }
 
-        m_ready.notify_one();
+        if (waitingCount != 0)
+            m_ready.notify_one();
+        if (isHighWatermark)
+            m_limits.onHighWatermark();
         return future;
     }
 
+    template <typename TaskT>
+    bool TryPost(TaskT &&task)
+    {
+        return TryPost(TaskPriority::Normal, std::forward<TaskT>(task));
+    }
+
+    // Task is consumed only if it was posted, so it is safe to retry with the same task.
+    // Full bounded queue fails regardless of admission policy.
+    template <typename TaskT>
+    bool TryPost(TaskPriority priority, TaskT &&task)
+    {
+        size_t waitingCount = 0;
+        bool isHighWatermark = false;
+        {
+            LockType lock{ m_mutex, std::try_to_lock };
+            if (!lock || !m_enabled || m_isClosed || IsFull())
+                return false;
+
+            PushLocked(priority, MakeTask(std::forward<TaskT>(task)));
+            waitingCount = m_waitingCount;
+            isHighWatermark = IsHighWatermarkReached();
+        }
+
+        if (waitingCount != 0)
+            m_ready.notify_one();
+        if (isHighWatermark)
+            m_limits.onHighWatermark();
+        return true;
+    }
+
+    // Moves up to count tasks of the source queue (highest priority first, they keep their priorities) to this queue,
+    // e.g. tasks queued behind a busy worker to a new one. Moved tasks are not checked against capacity.
+    // Both queues must use the same task counter.
+    size_t TakeTasks(TaskQueue& source, size_t count)
+    {
+        std::vector<std::pair<unsigned, TaskType>> tasks;
+        {
+            LockType lock{ source.m_mutex };
+            while (tasks.size() != count && source.m_levels != 0)
+            {
+                const auto level = FindFirstLevel(source.m_levels.load(std::memory_order_relaxed));
+                tasks.emplace_back(level, source.PopLocked(level));
+            }
+            source.OnPopped(lock);
+        }
+
+        if (tasks.empty())
+            return 0;
+
+        size_t waitingCount = 0;
+        {
+            LockType lock{ m_mutex };
+            for (auto& [level, task] : tasks)
+                InsertLocked(level, std::move(task));
+            waitingCount = m_waitingCount;
+        }
+
+        if (waitingCount != 0)
+            m_ready.notify_all();
+        return tasks.size();
+    }
+
+    // Drops queued tasks. They are destroyed outside of the lock: broken promises may post continuations.
+    void Clear()
+    {
+        std::array<RingBuffer<TaskType>, TaskPriorityCount> tasks;
+        size_t droppedCount = 0;
+        {
+            LockType lock{ m_mutex };
+            std::swap(tasks, m_queues);
+            m_levels.store(0, std::memory_order_relaxed);
+            droppedCount = m_size.exchange(0, std::memory_order_relaxed);
+            m_isAboveHighWatermark = false;
+        }
+        m_notFull.notify_all();
+
+        if (m_counter && droppedCount != 0)
+            m_counter->Done(droppedCount);
+    }
+
 private:
     TaskQueue(const TaskQueue &) = delete;
     TaskQueue &operator=(const TaskQueue &) = delete;
 
     using LockType = std::unique_lock<std::mutex>;
 
-    std::queue<TaskPtrType> m_queue;
+    enum class Admission
+    {
+        Accepted,
+        Rejected,
+        CallerRuns
+    };
+
+    bool IsFull() const
+    {
+        return m_limits.capacity != 0 && m_size.load(std::memory_order_relaxed) >= m_limits.capacity;
+    }
+
+    // Decides what to do with a new task, may wait for free space (the lock is released while waiting).
+    Admission Admit(LockType& lock)
+    {
+        if (!m_enabled || m_isClosed)
+            return Admission::Rejected;
+        if (!IsFull())
+            return Admission::Accepted;
+
+        switch (m_limits.admission)
+        {
+        case AdmissionPolicy::Try:
+            return Admission::Rejected;
+        case AdmissionPolicy::CallerRuns:
+            return Admission::CallerRuns;
+        case AdmissionPolicy::Block:
+            break;
+        }
+
+        // Worker waiting for space in a queue it (or its pool) consumes may never wake up.
+        if (t_consumedOwner == GetOwner())
+            return Admission::CallerRuns;
+
+        ++m_blockedCount;
+        m_notFull.wait(lock, [this] { return !m_enabled || m_isClosed || !IsFull(); });
+        --m_blockedCount;
+        return m_enabled && !m_isClosed ? Admission::Accepted : Admission::Rejected;
+    }
+
+    bool IsHighWatermarkReached()
+    {
+        if (m_limits.highWatermark == 0 || m_isAboveHighWatermark || m_size.load(std::memory_order_relaxed) < m_limits.highWatermark)
+            return false;
+
+        m_isAboveHighWatermark = true;
+        return static_cast<bool>(m_limits.onHighWatermark);
+    }
+
+    // Unlocks the queue after pop: wakes blocked producer and reports low watermark.
+    void OnPopped(LockType& lock)
+    {
+        const bool hasBlocked = m_blockedCount != 0;
+        bool isLowWatermark = false;
+        if (m_isAboveHighWatermark && m_size.load(std::memory_order_relaxed) <= m_limits.lowWatermark)
+        {
+            m_isAboveHighWatermark = false;
+            isLowWatermark = static_cast<bool>(m_limits.onLowWatermark);
+        }
+        lock.unlock();
+
+        if (hasBlocked)
+            m_notFull.notify_one();
+        if (isLowWatermark)
+            m_limits.onLowWatermark();
+    }
+
+    static unsigned LevelBit(TaskPriority priority)
+    {
+        return 1u << static_cast<unsigned>(priority);
+    }
+
+    static unsigned FindFirstLevel(unsigned levels)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, levels);
+        return index;
+#else
+        return static_cast<unsigned>(__builtin_ctz(levels));
+#endif
+    }
+
+    static unsigned FindLastLevel(unsigned levels)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanReverse(&index, levels);
+        return index;
+#else
+        return static_cast<unsigned>(31 - __builtin_clz(levels));
+#endif
+    }
+
+    void PushLocked(TaskPriority priority, TaskType&& task)
+    {
+        if (m_counter)
+            m_counter->Add();
+        InsertLocked(static_cast<unsigned>(priority), std::move(task));
+    }
+
+    void InsertLocked(unsigned level, TaskType&& task)
+    {
+        m_queues[level].Push(std::move(task));
+        m_levels.store(m_levels.load(std::memory_order_relaxed) | (1u << level), std::memory_order_relaxed);
+        m_size.store(m_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    TaskType PopLocked()
+    {
+        const auto levels = m_levels.load(std::memory_order_relaxed);
+        auto level = FindFirstLevel(levels);
+
+        if (m_agingLimit != 0 && (levels >> (level + 1)) != 0)
+        {
+            if (++m_skippedCount >= m_agingLimit)
+            {
+                level = FindLastLevel(levels);
+                m_skippedCount = 0;
+            }
+        }
+        else
+        {
+            m_skippedCount = 0;
+        }
+
+        return PopLocked(level);
+    }
+
+    const void* GetOwner() const
+    {
+        return m_owner ? m_owner : this;
+    }
+
+    TaskType PopLocked(unsigned level)
+    {
+        auto levels = m_levels.load(std::memory_order_relaxed);
+        auto task = m_queues[level].Pop();
+        if (m_queues[level].empty())
+            levels &= ~(1u << level);
+
+        m_levels.store(levels, std::memory_order_relaxed);
+        m_size.store(m_size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        return task;
+    }
+
+    std::array<RingBuffer<TaskType>, TaskPriorityCount> m_queues;
+    // Copies of queue state (modified under the lock) for checks without the lock.
+    std::atomic<unsigned> m_levels{ 0 }; // Bit per non-empty priority level
+    std::atomic<size_t> m_size{ 0 };
+    size_t m_agingLimit{ 64 };
+    size_t m_skippedCount{ 0 };   // Pops of higher priority tasks while lower ones are waiting
     bool m_enabled{ true };
+    bool m_isClosed{ false };
+    size_t m_waitingCount{ 0 };   // Parked workers
+    TaskQueueLimits m_limits;
+    detail::TaskCounter* m_counter{ nullptr };
+    const void* m_owner{ nullptr };
+    size_t m_blockedCount{ 0 };   // Producers waiting for free space
+    bool m_isAboveHighWatermark{ false };
     mutable std::mutex m_mutex;
     std::condition_variable m_ready;
+    std::condition_variable m_notFull;
+
+    static thread_local const void* t_consumedOwner; // Owner of queues the thread pops tasks from (pool of the worker)
 };
+
+thread_local const void* TaskQueue::t_consumedOwner{ nullptr };
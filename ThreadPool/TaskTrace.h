@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+/** The TaskTrace class records task events of thread pools (enqueue, dequeue, steal, start, end, park) and writes them
+* in Chrome Trace Event format, which is loaded by ui.perfetto.dev or chrome://tracing (one track per thread,
+* flow arrows from enqueue to start of every task).
+* Tracing is off until Start(). Then an event costs a clock read and a few relaxed stores into the ring buffer
+* of the calling thread (no locks, the oldest events are overwritten), registration of a thread takes the lock once.
+* Events are produced by the instrumentation of statistics, so nothing is traced if THREAD_POOL_STATS is 0.
+*/
+class TaskTrace
+{
+public:
+    enum class EventType : uint32_t
+    {
+        Enqueue,   // value - task id
+        Dequeue,
+        Steal,     // value - victim worker
+        Start,     // value - task id
+        End,       // value - task id
+        ParkBegin,
+        ParkEnd
+    };
+
+    static TaskTrace& Get()
+    {
+        static TaskTrace trace;
+        return trace;
+    }
+
+    // Drops events of the previous session. eventCount is capacity of the ring buffer of every thread.
+    void Start(size_t eventCount = 1 << 16)
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_buffers.clear();
+        m_eventCount = std::max<size_t>(eventCount, 1);
+        m_startTime = Now();
+        m_session.fetch_add(1, std::memory_order_relaxed);
+        m_isEnabled.store(true, std::memory_order_relaxed);
+    }
+
+    void Stop()
+    {
+        m_isEnabled.store(false, std::memory_order_relaxed);
+    }
+
+    bool IsEnabled() const
+    {
+        return m_isEnabled.load(std::memory_order_relaxed);
+    }
+
+    // Returns id of the enqueued task (0 if tracing is off).
+    static uint64_t RecordEnqueue()
+    {
+        auto& trace = Get();
+        if (!trace.IsEnabled())
+            return 0;
+
+        const auto id = trace.m_nextTaskId.fetch_add(1, std::memory_order_relaxed);
+        trace.GetThreadBuffer().Push(EventType::Enqueue, id);
+        return id;
+    }
+
+    static void Record(EventType type, uint64_t value = 0)
+    {
+        auto& trace = Get();
+        if (trace.IsEnabled())
+            trace.GetThreadBuffer().Push(type, value);
+    }
+
+    // Should be called when traced pools are idle or stopped: events recorded concurrently may be lost or mixed up.
+    void Write(std::ostream& stream) const
+    {
+        std::vector<std::shared_ptr<Buffer>> buffers;
+        uint64_t startTime = 0;
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            buffers = m_buffers;
+            startTime = m_startTime;
+        }
+
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+
+        bool isFirst = true;
+        const auto writeEvent = [&json, &isFirst](const char* name, const char* phase, size_t thread, double time) -> std::ostream& {
+            json << (isFirst ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"task\",\"ph\":\"" << phase
+                << "\",\"pid\":1,\"tid\":" << thread << ",\"ts\":" << time;
+            isFirst = false;
+            return json;
+        };
+
+        for (size_t thread = 0; thread != buffers.size(); ++thread)
+        {
+            writeEvent("thread_name", "M", thread, 0) << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+
+            const auto& buffer = *buffers[thread];
+            const auto count = buffer.GetCount();
+            const auto capacity = buffer.GetCapacity();
+            for (auto index = count > capacity ? count - capacity : 0; index != count; ++index)
+            {
+                const auto event = buffer.Get(index);
+                const auto time = static_cast<double>(std::max(event.time, startTime) - startTime)/1000; // us
+
+                switch (event.type)
+                {
+                case EventType::Enqueue:
+                    writeEvent("enqueue", "i", thread, time) << ",\"s\":\"t\",\"args\":{\"id\":" << event.value << "}}";
+                    writeEvent("task", "s", thread, time) << ",\"id\":" << event.value << "}";
+                    break;
+                case EventType::Dequeue:
+                    writeEvent("dequeue", "i", thread, time) << ",\"s\":\"t\"}";
+                    break;
+                case EventType::Steal:
+                    writeEvent("steal", "i", thread, time) << ",\"s\":\"t\",\"args\":{\"victim\":" << event.value << "}}";
+                    break;
+                case EventType::Start:
+                    writeEvent("task", "B", thread, time) << ",\"args\":{\"id\":" << event.value << "}}";
+                    if (event.value != 0)
+                        writeEvent("task", "f", thread, time) << ",\"bp\":\"e\",\"id\":" << event.value << "}";
+                    break;
+                case EventType::End:
+                    writeEvent("task", "E", thread, time) << "}";
+                    break;
+                case EventType::ParkBegin:
+                    writeEvent("park", "B", thread, time) << "}";
+                    break;
+                case EventType::ParkEnd:
+                    writeEvent("park", "E", thread, time) << "}";
+                    break;
+                }
+            }
+        }
+
+        json << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        stream << json.str();
+    }
+
+private:
+    // ns since epoch of steady clock
+    static uint64_t Now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    struct Event
+    {
+        uint64_t time;
+        uint64_t value;
+        EventType type;
+    };
+
+    /** Ring buffer of one thread. Only the owner thread writes, fields are atomic, so Write() may read them any time. */
+    class Buffer
+    {
+    public:
+        explicit Buffer(size_t capacity) : m_events(capacity) {}
+
+        void Push(EventType type, uint64_t value)
+        {
+            const auto count = m_count.load(std::memory_order_relaxed);
+            auto& event = m_events[count % m_events.size()];
+            event.time.store(Now(), std::memory_order_relaxed);
+            event.value.store(value, std::memory_order_relaxed);
+            event.type.store(static_cast<uint32_t>(type), std::memory_order_relaxed);
+            m_count.store(count + 1, std::memory_order_release);
+        }
+
+        Event Get(uint64_t index) const
+        {
+            const auto& event = m_events[index % m_events.size()];
+            return Event{ event.time.load(std::memory_order_relaxed), event.value.load(std::memory_order_relaxed),
+                static_cast<EventType>(event.type.load(std::memory_order_relaxed)) };
+        }
+
+        uint64_t GetCount() const
+        {
+            return m_count.load(std::memory_order_acquire);
+        }
+
+        uint64_t GetCapacity() const
+        {
+            return m_events.size();
+        }
+
+    private:
+        struct AtomicEvent
+        {
+            std::atomic<uint64_t> time{ 0 };
+            std::atomic<uint64_t> value{ 0 };
+            std::atomic<uint32_t> type{ 0 };
+        };
+
+        std::vector<AtomicEvent> m_events;
+        std::atomic<uint64_t>    m_count{ 0 };
+    };
+
+    // Buffer of the calling thread for the current session. Buffers of the previous session are released by their threads,
+    // so Start() never frees a buffer which is being written.
+    Buffer& GetThreadBuffer()
+    {
+        struct ThreadBuffer
+        {
+            std::shared_ptr<Buffer> buffer;
+            uint64_t session{ 0 };
+        };
+        static thread_local ThreadBuffer t_buffer;
+
+        if (t_buffer.session != m_session.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            t_buffer.buffer = std::make_shared<Buffer>(m_eventCount);
+            t_buffer.session = m_session.load(std::memory_order_relaxed);
+            m_buffers.push_back(t_buffer.buffer);
+        }
+        return *t_buffer.buffer;
+    }
+
+    TaskTrace() = default;
+    TaskTrace(const TaskTrace&) = delete;
+    TaskTrace& operator=(const TaskTrace&) = delete;
+
+    std::atomic<bool>     m_isEnabled{ false };
+    std::atomic<uint64_t> m_session{ 0 };
+    std::atomic<uint64_t> m_nextTaskId{ 1 };
+
+    mutable std::mutex                   m_mutex;
+    size_t                               m_eventCount{ 0 };
+    uint64_t                             m_startTime{ 0 };
+    std::vector<std::shared_ptr<Buffer>> m_buffers; // Index is track (tid) of the thread
+};
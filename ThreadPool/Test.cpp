@@ -2,31 +2,1053 @@
 #include "MultiQueueThreadPool.h"
 #include "WorkStealingThreadPool.h"
 #include "AsioThreadPool.h"
+#include "TaskGraph.h"
+#include "TaskGroup.h"
+#include "TaskTrace.h"
+#include "ParallelAlgorithms.h"
+#include "Strand.h"
 #ifdef _MSC_VER
 #include "PplThreadPool.h"
 #endif
+#include "Common/HdrHistogram.h"
 #include "Common/TestUtilities.h"
+#include "Common/ZipIterator.h"
+
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
 
 template<class TaskSystemT>
 void Test_TaskResultIsAsExpected(TaskSystemT&& taskSystem = TaskSystemT{})
 {
-    constexpr size_t taskCount = 10000;
+    constexpr size_t taskCount = 10000;
+
+    std::vector<Future<size_t>> results;
+
+    for (size_t i = 0; i < taskCount; ++i)
+        results.push_back(taskSystem.ExecuteAsync([i] { return i*i; }));
+
+    for (size_t i = 0; i < taskCount; ++i)
+        TEST_ASSERT(i*i == results[i].get());
+}
+
+template<class TaskSystemT>
+void Test_TaskExceptionIsPropagated(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    auto result = taskSystem.ExecuteAsync([]() -> size_t { throw std::logic_error("task failed"); });
+
+    try
+    {
+        result.get();
+    }
+    catch (const std::logic_error&)
+    {
+        return;
+    }
+    TEST_ASSERT(false && "exception was not propagated");
+}
+
+template<class TaskSystemT>
+void Test_TaskReferenceResultIsReturned(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    int value = 0;
+    auto result = taskSystem.ExecuteAsync([&value]() -> int& { return value; });
+    int& reference = result.get();
+    TEST_ASSERT(&value == &reference);
+
+    auto next = taskSystem.ExecuteAsync([&value]() -> const int& { return value; })
+        .Then([](Future<const int&> parent) -> const int& { return parent.get(); });
+    TEST_ASSERT(&value == &next.get());
+}
+
+void Test_BrokenPromiseIsReported()
+{
+    Future<int> future;
+    {
+        Promise<int> promise;
+        future = promise.get_future();
+        TEST_ASSERT(std::future_status::timeout == future.wait_for(std::chrono::milliseconds(1)));
+    }
+
+    try
+    {
+        future.get();
+    }
+    catch (const std::future_error& error)
+    {
+        TEST_ASSERT(std::future_errc::broken_promise == error.code());
+        TEST_ASSERT(!future.valid());
+        return;
+    }
+    TEST_ASSERT(false && "broken promise was not reported");
+}
+
+template<class TaskSystemT>
+void Test_TaskBatchResultIsAsExpected(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 10000;
+
+    std::vector<std::function<size_t()>> tasks;
+    for (size_t i = 0; i < taskCount; ++i)
+        tasks.emplace_back([i] { return i*i; });
+
+    auto results = taskSystem.ExecuteBatch(tasks.begin(), tasks.end());
+
+    TEST_ASSERT(taskCount == results.size());
+    for (size_t i = 0; i < taskCount; ++i)
+        TEST_ASSERT(i*i == results[i].get());
+}
+
+template<class TaskSystemT>
+void Test_PostedTasksAreExecuted(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 10000;
+
+    std::atomic<size_t> executed{ 0 };
+
+    for (size_t i = 0; i < taskCount; ++i)
+        taskSystem.Post([&executed] { ++executed; });
+
+    // There is no result channel, so just wait until all tasks are done.
+    taskSystem.WaitIdle();
+    TEST_ASSERT(taskCount == executed);
+}
+
+template<class TaskSystemT>
+void Test_TaskWithLargeCaptureIsExecuted(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    // Doesn't fit into inline storage of task queue slot, so it has to be allocated on heap.
+    std::array<size_t, 64> payload;
+    std::iota(payload.begin(), payload.end(), size_t{ 0 });
+
+    auto result = taskSystem.ExecuteAsync([payload] { return std::accumulate(payload.begin(), payload.end(), size_t{ 0 }); });
+    TEST_ASSERT(std::accumulate(payload.begin(), payload.end(), size_t{ 0 }) == result.get());
+}
+
+template<class TaskSystemT>
+void Test_NestedTasksAreExecuted(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t outerTaskCount = 100;
+    constexpr size_t innerTaskCount = 100;
+
+    std::atomic<size_t> executed{ 0 };
+    std::vector<Future<std::vector<Future<void>>>> results;
+
+    // Tasks must not block on each other: with single worker it would be a deadlock.
+    for (size_t i = 0; i < outerTaskCount; ++i)
+    {
+        results.push_back(taskSystem.ExecuteAsync([&] {
+            std::vector<Future<void>> innerResults;
+            for (size_t j = 0; j < innerTaskCount; ++j)
+                innerResults.push_back(taskSystem.ExecuteAsync([&] { ++executed; }));
+            return innerResults;
+        }));
+    }
+
+    for (auto& result : results)
+    {
+        for (auto& innerResult : result.get())
+            innerResult.wait();
+    }
+
+    TEST_ASSERT(outerTaskCount*innerTaskCount == executed);
+}
+
+template<class TaskSystemT>
+void Test_ContinuationsAreExecuted(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    const auto callerId = std::this_thread::get_id();
+
+    auto result = taskSystem.ExecuteAsync([] { return 1; })
+        .Then([](Future<int> value) { return value.get() + 1; })
+        .Then([](Future<int> value) { return std::to_string(value.get()); })
+        .Then([callerId](Future<std::string> value) { return std::make_pair(value.get(), std::this_thread::get_id() != callerId); });
+
+    const auto [value, isExecutedByPool] = result.get();
+    TEST_ASSERT("2" == value);
+    TEST_ASSERT(isExecutedByPool);
+
+    auto error = taskSystem.ExecuteAsync([] { throw std::runtime_error{ "error" }; })
+        .Then([](Future<void> value) { value.get(); return 1; });
+
+    bool isThrown = false;
+    try
+    {
+        error.get();
+    }
+    catch (const std::runtime_error&)
+    {
+        isThrown = true;
+    }
+    TEST_ASSERT(isThrown);
+}
+
+template<class TaskSystemT>
+void Test_WhenAllIsReadyWhenAllTasksAreDone(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 100;
+
+    std::vector<Future<size_t>> futures;
+    for (size_t i = 0; i < taskCount; ++i)
+        futures.push_back(taskSystem.ExecuteAsync([i] { return i; }));
+
+    auto all = WhenAll(futures.begin(), futures.end()).Then([](Future<std::vector<Future<size_t>>> results) {
+        size_t sum = 0;
+        for (auto& result : results.get())
+            sum += result.get();
+        return sum;
+    });
+    TEST_ASSERT(taskCount*(taskCount - 1)/2 == all.get());
+
+    auto tuple = WhenAll(taskSystem.ExecuteAsync([] { return 1; }), taskSystem.ExecuteAsync([] { return std::string{ "2" }; })).get();
+    TEST_ASSERT(1 == std::get<0>(tuple).get());
+    TEST_ASSERT("2" == std::get<1>(tuple).get());
+
+    std::vector<Future<size_t>> empty;
+    TEST_ASSERT(WhenAll(empty.begin(), empty.end()).get().empty());
+}
+
+template<class TaskSystemT>
+void Test_WhenAnyIsReadyWhenFirstTaskIsDone(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    Promise<int> never;
+
+    auto any = WhenAny(never.get_future(), taskSystem.ExecuteAsync([] { return 2; })).get();
+    TEST_ASSERT(1 == any.index);
+    TEST_ASSERT(2 == std::get<1>(any.futures).get());
+
+    never.set_value(1);
+    TEST_ASSERT(1 == std::get<0>(any.futures).get());
+
+    std::vector<Future<int>> empty;
+    TEST_ASSERT(static_cast<size_t>(-1) == WhenAny(empty.begin(), empty.end()).get().index);
+}
+
+// Continuation attached to a future taken back from WhenAny races with completion of its promise
+// (the future has the continuation of WhenAny already).
+template<class TaskSystemT>
+void Test_ContinuationAfterWhenAnyRacesWithCompletion(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t iterationCount = 20000;
+
+    for (size_t i = 0; i < iterationCount; ++i)
+    {
+        Promise<int> late;
+        Promise<int> first;
+        auto any = WhenAny(late.get_future(), first.get_future());
+        first.set_value(1);
+        auto futures = any.get().futures;
+
+        // Both sides start together, so on several cores they overlap.
+        std::atomic<int> barrier{ 0 };
+        auto completion = taskSystem.ExecuteAsync([&late, &barrier] {
+            for (++barrier; barrier != 2;)
+                std::this_thread::yield();
+            late.set_value(2);
+        });
+        for (++barrier; barrier != 2;)
+            std::this_thread::yield();
+        auto next = std::get<0>(futures).Then([](Future<int> value) { return value.get() + 1; });
+
+        completion.get();
+        TEST_ASSERT(3 == next.get());
+    }
+}
+
+template<class TaskSystemT>
+void Test_TaskGraphResultIsAsExpected(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t runCount = 100;
+
+    // ("Hello" + " ") + ("World" + "!"): results of nodes are owned by the caller, graph owns only callables.
+    std::array<std::string, 7> parts;
+    TaskGraph graph;
+
+    const auto hello = graph.AddNode([&parts] { parts[0] = "Hello"; });
+    const auto space = graph.AddNode([&parts] { parts[1] = " "; });
+    const auto world = graph.AddNode([&parts] { parts[2] = "World"; });
+    const auto exclamationPoint = graph.AddNode([&parts] { parts[3] = "!"; });
+    const auto firstPart = graph.AddNode([&parts] { parts[4] = parts[0] + parts[1]; }, { hello, space });
+    const auto secondPart = graph.AddNode([&parts] { parts[5] = parts[2] + parts[3]; }, { world, exclamationPoint });
+    graph.AddNode([&parts] { parts[6] = parts[4] + parts[5]; }, { firstPart, secondPart });
+
+    for (size_t n = 0; n < runCount; ++n)
+    {
+        parts.fill({});
+        graph.Run(taskSystem);
+        TEST_ASSERT("Hello World!" == parts[6]);
+    }
+
+    // Failed node skips the rest of the graph.
+    std::atomic<size_t> executed{ 0 };
+    TaskGraph failingGraph;
+    const auto failing = failingGraph.AddNode([] { throw std::runtime_error{ "error" }; });
+    failingGraph.AddNode([&executed] { ++executed; }, { failing });
+
+    bool isThrown = false;
+    try
+    {
+        failingGraph.Run(taskSystem);
+    }
+    catch (const std::runtime_error&)
+    {
+        isThrown = true;
+    }
+    TEST_ASSERT(isThrown);
+    TEST_ASSERT(0 == executed);
+
+    TaskGraph cyclicGraph;
+    const auto first = cyclicGraph.AddNode([] {});
+    const auto second = cyclicGraph.AddNode([] {}, { first });
+    cyclicGraph.AddEdge(second, first);
+
+    isThrown = false;
+    try
+    {
+        cyclicGraph.Run(taskSystem);
+    }
+    catch (const std::logic_error&)
+    {
+        isThrown = true;
+    }
+    TEST_ASSERT(isThrown);
+}
+
+template<class TaskSystemT>
+void Test_ParallelForProcessesAllElements(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t elementCount = 10000;
+
+    const std::vector<ParallelOptions> optionsList = {
+        { Partitioning::Static, 0 }, { Partitioning::Dynamic, 0 }, { Partitioning::Guided, 0 },
+        { Partitioning::Static, 100 }, { Partitioning::Dynamic, 1 }, { Partitioning::Guided, 7 } };
+
+    for (const auto& options : optionsList)
+    {
+        std::vector<size_t> input(elementCount);
+        ParallelFor(taskSystem, MakeIndexRange(size_t{ 0 }, elementCount), [&input](size_t index) { input[index] = index; }, options);
+
+        std::vector<size_t> output(elementCount);
+        ParallelFor(taskSystem, MakeZipContainer(input, output), [](auto element) { std::get<1>(element) = 2*std::get<0>(element); }, options);
+
+        for (size_t index = 0; index < elementCount; ++index)
+            TEST_ASSERT(2*index == output[index]);
+    }
+
+    // Nested loop must not wait for helpers queued behind the calling task.
+    auto nested = taskSystem.ExecuteAsync([&taskSystem] {
+        std::atomic<size_t> count{ 0 };
+        ParallelFor(taskSystem, MakeIndexRange(0, 1000), [&count](int) { ++count; });
+        return count.load();
+    });
+    TEST_ASSERT(1000 == nested.get());
+
+    bool isThrown = false;
+    try
+    {
+        ParallelFor(taskSystem, MakeIndexRange(0, 1000), [](int index) { if (index == 500) throw std::runtime_error{ "error" }; });
+    }
+    catch (const std::runtime_error&)
+    {
+        isThrown = true;
+    }
+    TEST_ASSERT(isThrown);
+}
+
+template<class TaskSystemT>
+void Test_ParallelReduceResultIsAsExpected(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t elementCount = 100000;
+
+    for (const auto partitioning : { Partitioning::Static, Partitioning::Dynamic, Partitioning::Guided })
+    {
+        const auto sum = ParallelReduce(taskSystem, MakeIndexRange(size_t{ 0 }, elementCount), size_t{ 0 }, std::plus<>{}, ParallelOptions{ partitioning, 0 });
+        TEST_ASSERT(elementCount*(elementCount - 1)/2 == sum);
+    }
+
+    std::vector<int> input1(1000, 2);
+    std::vector<int> input2(1000, 3);
+    const auto dotProduct = ParallelReduce(taskSystem, MakeZipContainer(input1, input2), 0,
+        [](int partial, auto element) { return partial + std::get<0>(element)*std::get<1>(element); },
+        std::plus<>{});
+    TEST_ASSERT(6000 == dotProduct);
+}
+
+void Test_CpuTopologyIsDetected()
+{
+    TEST_ASSERT(std::vector<size_t>({ 0, 1, 2, 3, 8, 10, 11 }) == CpuTopology::ParseCpuList("0-3,8,10-11\n"));
+
+    const auto& topology = CpuTopology::Get();
+    TEST_ASSERT(topology.GetNodeCount() >= 1);
+    TEST_ASSERT(!topology.GetCpus().empty());
+}
+
+template<class TaskSystemT>
+void Test_PinnedWorkersExecuteTasks()
+{
+    constexpr size_t taskCount = 100;
+
+    for (const auto affinity : { ThreadAffinity::Core, ThreadAffinity::Node })
+    {
+        TaskSystemT taskSystem{ ThreadPoolOptions{ 2, affinity } };
+
+        std::vector<Future<size_t>> results;
+        for (size_t i = 0; i < taskCount; ++i)
+        {
+            results.push_back(taskSystem.ExecuteAsync([] {
+#ifdef __linux__
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+                return static_cast<size_t>(CPU_COUNT(&cpus));
+#else
+                return size_t{ 1 };
+#endif
+            }));
+        }
+
+        for (auto& result : results)
+        {
+            const auto cpuCount = result.get();
+            TEST_ASSERT(affinity == ThreadAffinity::Core ? cpuCount == 1 : cpuCount >= 1);
+        }
+    }
+}
+
+template<class TaskSystemT>
+void Test_WaitPolicyDoesNotLoseTasks()
+{
+    using namespace std::chrono_literals;
+    constexpr size_t burstCount = 20;
+    constexpr size_t taskCount = 100;
+
+    // Parking immediately, default spinning and long spinning.
+    for (const auto waitPolicy : { WaitPolicy{ 0, 0 }, WaitPolicy{}, WaitPolicy{ 100, 1000 } })
+    {
+        ThreadPoolOptions options;
+        options.threadCount = 2;
+        options.waitPolicy = waitPolicy;
+        TaskSystemT taskSystem{ options };
+
+        std::atomic<size_t> executed{ 0 };
+        for (size_t burst = 0; burst < burstCount; ++burst)
+        {
+            std::vector<Future<void>> results;
+            for (size_t i = 0; i < taskCount; ++i)
+                results.push_back(taskSystem.ExecuteAsync([&executed] { ++executed; }));
+
+            for (auto& result : results)
+                result.wait();
+
+            // Let workers spin out and park.
+            std::this_thread::sleep_for(1ms);
+        }
+
+        TEST_ASSERT(burstCount*taskCount == executed);
+    }
+}
+
+template<class TaskSystemT>
+void Test_HighPriorityTaskIsExecutedFirst()
+{
+    constexpr size_t taskCount = 100;
+
+    for (const size_t agingLimit : { 0, 4 })
+    {
+        ThreadPoolOptions options;
+        options.threadCount = 1;
+        options.priorityAgingLimit = agingLimit;
+        TaskSystemT taskSystem{ options };
+
+        // The only worker is blocked until all tasks are queued.
+        Promise<void> gate;
+        auto blocker = taskSystem.ExecuteAsync([opened = gate.get_future()]() mutable { opened.wait(); });
+
+        std::vector<size_t> order;
+        std::vector<Future<void>> results;
+        results.push_back(taskSystem.ExecuteAsync(TaskPriority::Low, [&order] { order.push_back(0); }));
+        for (size_t i = 1; i < taskCount; ++i)
+            results.push_back(taskSystem.ExecuteAsync(TaskPriority::High, [&order, i] { order.push_back(i); }));
+
+        gate.set_value();
+        for (auto& result : results)
+            result.wait();
+
+        const auto lowPosition = static_cast<size_t>(std::find(order.begin(), order.end(), 0) - order.begin());
+        // Without aging the low priority task is the last one, otherwise it waits at most agingLimit pops.
+        TEST_ASSERT(agingLimit == 0 ? lowPosition == taskCount - 1 : lowPosition <= agingLimit);
+    }
+}
+
+template<class TaskSystemT>
+void Test_BoundedQueueAppliesAdmissionPolicy()
+{
+    using namespace std::chrono_literals;
+    constexpr size_t capacity = 4;
+
+    for (const auto admission : { AdmissionPolicy::Block, AdmissionPolicy::Try, AdmissionPolicy::CallerRuns })
+    {
+        std::atomic<size_t> highWatermarkCount{ 0 };
+        std::atomic<size_t> lowWatermarkCount{ 0 };
+
+        ThreadPoolOptions options;
+        options.threadCount = 1;
+        options.queueLimits.capacity = capacity;
+        options.queueLimits.admission = admission;
+        options.queueLimits.highWatermark = capacity;
+        options.queueLimits.lowWatermark = 1;
+        options.queueLimits.onHighWatermark = [&highWatermarkCount] { ++highWatermarkCount; };
+        options.queueLimits.onLowWatermark = [&lowWatermarkCount] { ++lowWatermarkCount; };
+        TaskSystemT taskSystem{ options };
+
+        // The only worker is blocked until the queue is full.
+        Promise<void> gate;
+        Promise<void> started;
+        auto startedFuture = started.get_future();
+        auto blocker = taskSystem.ExecuteAsync([&started, opened = gate.get_future()]() mutable {
+            started.set_value();
+            opened.wait();
+        });
+        startedFuture.wait();
+
+        std::atomic<size_t> executed{ 0 };
+        for (size_t i = 0; i < capacity; ++i)
+            TEST_ASSERT(taskSystem.Post([&executed] { ++executed; }));
+        TEST_ASSERT(1 == highWatermarkCount);
+
+        std::atomic<bool> isOpened{ false };
+        std::thread opener{ [&gate, &isOpened] {
+            std::this_thread::sleep_for(10ms);
+            isOpened = true;
+            gate.set_value();
+        } };
+
+        const auto callerId = std::this_thread::get_id();
+        auto overflow = taskSystem.ExecuteAsync([callerId] { return std::this_thread::get_id() == callerId; });
+        opener.join();
+
+        switch (admission)
+        {
+        case AdmissionPolicy::Block:
+            TEST_ASSERT(isOpened);
+            TEST_ASSERT(!overflow.get());
+            break;
+        case AdmissionPolicy::Try:
+            TEST_ASSERT(overflow.is_ready());
+            try
+            {
+                overflow.get();
+                TEST_ASSERT(false);
+            }
+            catch (const TaskRejectedError&)
+            {
+            }
+            break;
+        case AdmissionPolicy::CallerRuns:
+            TEST_ASSERT(overflow.get());
+            break;
+        }
+
+        blocker.wait();
+        while (executed != capacity)
+            std::this_thread::yield();
+        TEST_ASSERT(1 == lowWatermarkCount);
+    }
+}
+
+template<class TaskSystemT>
+void Test_WorkerBlocksOnFullQueueOfAnotherPool(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    using namespace std::chrono_literals;
+
+    ThreadPoolOptions options;
+    options.threadCount = 1;
+    options.queueLimits.capacity = 1;
+    options.queueLimits.admission = AdmissionPolicy::Block;
+    TaskSystemT boundedTaskSystem{ options };
+
+    // The only worker of bounded pool is blocked and its queue is full.
+    Promise<void> gate;
+    Promise<void> started;
+    auto startedFuture = started.get_future();
+    auto blocker = boundedTaskSystem.ExecuteAsync([&started, opened = gate.get_future()]() mutable {
+        started.set_value();
+        opened.wait();
+    });
+    startedFuture.wait();
+    TEST_ASSERT(boundedTaskSystem.Post([] {}));
+
+    std::atomic<bool> isOpened{ false };
+    std::thread opener{ [&gate, &isOpened] {
+        std::this_thread::sleep_for(10ms);
+        isOpened = true;
+        gate.set_value();
+    } };
+
+    // Worker of another pool waits for free space like any other thread, only own pool's workers run the task themselves.
+    auto isBlocked = taskSystem.ExecuteAsync([&boundedTaskSystem, &isOpened] {
+        const auto workerId = std::this_thread::get_id();
+        auto overflow = boundedTaskSystem.ExecuteAsync([workerId] { return std::this_thread::get_id() != workerId; });
+        const bool wasOpened = isOpened;
+        return wasOpened && overflow.get();
+    });
+    TEST_ASSERT(isBlocked.get());
+    opener.join();
+    blocker.wait();
+}
+
+template<class TaskSystemT>
+void Test_WaitIdleWaitsForNestedTasks(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 1000;
+
+    std::atomic<size_t> executed{ 0 };
+    for (size_t i = 0; i < taskCount; ++i)
+    {
+        taskSystem.Post([&taskSystem, &executed] {
+            taskSystem.Post([&executed] { ++executed; });
+            ++executed;
+        });
+    }
+
+    taskSystem.WaitIdle();
+    TEST_ASSERT(2*taskCount == executed);
+}
+
+template<class TaskSystemT>
+void Test_TaskGroupWaitsForItsTasks(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 1000;
+
+    std::atomic<size_t> executed{ 0 };
+    TaskGroup group;
+    for (size_t i = 0; i < taskCount; ++i)
+        group.Run(taskSystem, [&executed] { ++executed; });
+
+    group.Wait();
+    TEST_ASSERT(taskCount == executed);
+    TEST_ASSERT(0 == group.GetPendingCount());
+
+    group.Run(taskSystem, [] { throw std::runtime_error{ "error" }; });
+    bool isThrown = false;
+    try
+    {
+        group.Wait();
+    }
+    catch (const std::runtime_error&)
+    {
+        isThrown = true;
+    }
+    TEST_ASSERT(isThrown);
+}
+
+// Group is destroyed as soon as its last task is done (a worker may be still inside of TaskCounter::Done).
+template<class TaskSystemT>
+void Test_TaskGroupIsDestroyedRightAfterLastTask(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t groupCount = 20000;
+    constexpr size_t taskCount = 4;
+
+    std::atomic<size_t> executed{ 0 };
+    for (size_t n = 0; n < groupCount; ++n)
+    {
+        TaskGroup group;
+        for (size_t i = 0; i < taskCount; ++i)
+            group.Run(taskSystem, [&executed] { ++executed; });
+    }
+    TEST_ASSERT(groupCount*taskCount == executed);
+}
+
+template<class TaskSystemT>
+void Test_ShutdownDrainExecutesQueuedTasks()
+{
+    constexpr size_t taskCount = 1000;
+
+    ThreadPoolOptions options;
+    options.threadCount = 2;
+    TaskSystemT taskSystem{ options };
+
+    std::atomic<size_t> executed{ 0 };
+    for (size_t i = 0; i < taskCount; ++i)
+        taskSystem.Post([&executed] { ++executed; });
+
+    taskSystem.Shutdown(ShutdownMode::Drain);
+    TEST_ASSERT(taskCount == executed);
+    TEST_ASSERT(!taskSystem.Post([] {}));
+}
+
+template<class TaskSystemT>
+void Test_ElasticPoolGrowsAndShrinks()
+{
+    using namespace std::chrono_literals;
+
+    constexpr size_t taskCount = 4;
+
+    ThreadPoolOptions options;
+    options.threadCount = taskCount;
+    options.minThreadCount = 1;
+    options.idleTimeout = 20ms;
+    options.scaleInterval = 1ms;
+    TaskSystemT taskSystem{ options };
+    TEST_ASSERT(1 == taskSystem.GetThreadCount());
+
+    // Tasks wait for each other, so they complete only if the pool grows to run all of them at once.
+    std::atomic<size_t> running{ 0 };
+    std::atomic<bool> isMet{ true };
+    for (size_t i = 0; i < taskCount; ++i)
+    {
+        taskSystem.Post([&running, &isMet] {
+            ++running;
+            const auto deadline = std::chrono::steady_clock::now() + 10s;
+            while (running != taskCount)
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    isMet = false;
+                    break;
+                }
+                std::this_thread::sleep_for(1ms);
+            }
+        });
+    }
+
+    taskSystem.WaitIdle();
+    TEST_ASSERT(isMet);
+
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (taskSystem.GetThreadCount() != 1 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    TEST_ASSERT(1 == taskSystem.GetThreadCount());
+
+    // Pool keeps working with its minimal worker count.
+    TEST_ASSERT(42 == taskSystem.ExecuteAsync([] { return 42; }).get());
+}
+
+template<class TaskSystemT>
+void Test_StatsCountExecutedTasks(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 1000;
+
+    for (size_t i = 0; i < taskCount; ++i)
+        taskSystem.Post([] {});
+    taskSystem.WaitIdle();
+
+    const auto stats = taskSystem.GetStats();
+    TEST_ASSERT(taskSystem.GetThreadCount() == stats.threadCount);
+    TEST_ASSERT(0 == stats.pendingCount);
+    TEST_ASSERT(0 == stats.queuedCount);
+#if THREAD_POOL_STATS
+    const auto total = stats.GetTotal();
+    TEST_ASSERT(taskCount == total.executedCount);
+    TEST_ASSERT(taskCount == total.queueLatency.GetCount());
+    TEST_ASSERT(total.queueLatency.GetPercentile(0.5) <= total.queueLatency.GetPercentile(0.99));
+#endif
+}
+
+template<class TaskSystemT>
+void Test_TaskTraceRecordsTasks(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 100;
+
+    auto& trace = TaskTrace::Get();
+    trace.Start();
+    for (size_t i = 0; i < taskCount; ++i)
+        taskSystem.Post([] {});
+    taskSystem.WaitIdle();
+    trace.Stop();
+
+    std::ostringstream json;
+    trace.Write(json);
+    const auto text = json.str();
+
+    const auto countOf = [&text](const std::string& pattern) {
+        size_t count = 0;
+        for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+            ++count;
+        return count;
+    };
+
+    TEST_ASSERT(0 == text.find("{\"traceEvents\":["));
+#if THREAD_POOL_STATS
+    TEST_ASSERT(taskCount == countOf("\"name\":\"enqueue\""));
+    TEST_ASSERT(taskCount <= countOf("\"name\":\"task\",\"cat\":\"task\",\"ph\":\"B\""));
+#endif
+}
+
+template<class TaskSystemT>
+void Test_CancelledTasksAreSkipped()
+{
+    constexpr size_t taskCount = 100;
+
+    ThreadPoolOptions options;
+    options.threadCount = 1;
+    TaskSystemT taskSystem{ options };
+
+    // The only worker is blocked, so cancellable tasks wait in the queue until they are cancelled.
+    std::promise<void> unblock;
+    auto blocker = taskSystem.ExecuteAsync([released = unblock.get_future().share()] { released.wait(); });
+
+    CancellationSource source;
+    std::atomic<size_t> executed{ 0 };
+    std::vector<Future<void>> futures;
+    for (size_t i = 0; i < taskCount; ++i)
+    {
+        futures.push_back(taskSystem.ExecuteAsync(source.GetToken(), [&executed] { ++executed; }));
+        TEST_ASSERT(taskSystem.Post(source.GetToken(), [&executed] { ++executed; }));
+    }
+    auto notCancelled = taskSystem.ExecuteAsync(CancellationSource{}.GetToken(), [] {
+        return CancellationToken::GetCurrent().CanBeCancelled() && !CancellationToken::GetCurrent().IsCancellationRequested();
+    });
+
+    source.Cancel();
+    unblock.set_value();
+    blocker.get();
+
+    for (auto& future : futures)
+    {
+        try
+        {
+            future.get();
+            TEST_ASSERT(false);
+        }
+        catch (const TaskCancelledError&)
+        {
+        }
+    }
+    TEST_ASSERT(notCancelled.get());
+    taskSystem.WaitIdle();
+    TEST_ASSERT(0 == executed);
+    TEST_ASSERT(!CancellationToken::GetCurrent().CanBeCancelled());
+
+    // Running task sees cancellation through its token.
+    CancellationSource longSource;
+    std::promise<void> started;
+    auto longTask = taskSystem.ExecuteAsync(longSource.GetToken(), [&started] {
+        started.set_value();
+        while (!CancellationToken::GetCurrent().IsCancellationRequested())
+            std::this_thread::yield();
+        return true;
+    });
+    started.get_future().wait();
+    longSource.Cancel();
+    TEST_ASSERT(longTask.get());
+}
+
+// Every sequence must be executed in order, one task at a time.
+template<class ExecutorT>
+void PostOrderedTasks(ExecutorT&& execute, size_t sequenceCount, size_t taskCount)
+{
+    struct Sequence
+    {
+        std::atomic<bool> isRunning{ false };
+        size_t next{ 0 };
+        bool isOrdered{ true };
+    };
+
+    std::vector<Sequence> sequences(sequenceCount);
+    std::vector<Future<void>> futures;
+    for (size_t i = 0; i < taskCount; ++i)
+    {
+        for (size_t key = 0; key < sequenceCount; ++key)
+        {
+            futures.push_back(execute(key, [&sequence = sequences[key], i] {
+                if (sequence.isRunning.exchange(true))
+                    sequence.isOrdered = false;
+                if (sequence.next++ != i)
+                    sequence.isOrdered = false;
+                sequence.isRunning = false;
+            }));
+        }
+    }
+
+    for (auto& future : futures)
+        future.get();
+    for (const auto& sequence : sequences)
+    {
+        TEST_ASSERT(sequence.isOrdered);
+        TEST_ASSERT(taskCount == sequence.next);
+    }
+}
+
+template<class TaskSystemT>
+void Test_StrandExecutesTasksInOrder(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    std::vector<Strand> strands;
+    for (size_t i = 0; i < 8; ++i)
+        strands.emplace_back(taskSystem);
+
+    PostOrderedTasks([&strands](size_t key, auto&& task) { return strands[key].ExecuteAsync(std::move(task)); }, strands.size(), 1000);
+}
+
+template<size_t MinThreadCount>
+void Test_KeyedTasksAreExecutedInOrder()
+{
+    ThreadPoolOptions options;
+    options.threadCount = 4;
+    options.minThreadCount = MinThreadCount; // Elastic pool uses strands
+    MultiQueueThreadPool taskSystem{ options };
+
+    PostOrderedTasks([&taskSystem](size_t key, auto&& task) { return taskSystem.ExecuteAsync(key, std::move(task)); }, 16, 1000);
+}
+
+void Test_TwoChoicesSelectShorterQueue()
+{
+    constexpr size_t taskCount = 100;
 
-    std::vector<std::future<size_t>> results;
+    ThreadPoolOptions options;
+    options.threadCount = 2;
+    options.queueSelection = QueueSelection::TwoChoices;
+    MultiQueueThreadPool taskSystem{ options };
 
-    for (size_t i = 0; i < taskCount; ++i)
-        results.push_back(taskSystem.ExecuteAsync([i] { return i*i; }));
+    // Both workers are blocked (keys are hashed to queues 0 and 1), so queue sizes change only by posting.
+    std::promise<void> unblock;
+    const auto released = unblock.get_future().share();
+    std::atomic<size_t> started{ 0 };
+    for (size_t key = 0; key < 2; ++key)
+        taskSystem.Post(key, [released, &started] { ++started; released.wait(); });
+    while (started != 2)
+        std::this_thread::yield();
 
     for (size_t i = 0; i < taskCount; ++i)
-        TEST_ASSERT(i*i == results[i].get());
+        taskSystem.Post(size_t{ 0 }, [] {});
+    // With two queues both are sampled, so new tasks go to the shorter one until sizes are equal.
+    for (size_t i = 0; i < taskCount; ++i)
+        taskSystem.Post([] {});
+
+    const auto stats = taskSystem.GetStats();
+    TEST_ASSERT(taskCount == stats.workers[0].queueSize);
+    TEST_ASSERT(taskCount == stats.workers[1].queueSize);
+
+    unblock.set_value();
+    taskSystem.WaitIdle();
+}
+
+template<bool IsContextPerThread>
+void Test_AsioKeyedTasksAreExecutedInOrder()
+{
+    ThreadPoolOptions options;
+    options.threadCount = 4;
+    options.ioContextPerThread = IsContextPerThread; // Otherwise keys are hashed to strands
+    AsioThreadPool taskSystem{ options };
+
+    PostOrderedTasks([&taskSystem](size_t key, auto&& task) { return taskSystem.ExecuteAsync(key, std::move(task)); }, 16, 1000);
+
+    std::atomic<size_t> executed{ 0 };
+    for (size_t i = 0; i < 1000; ++i)
+        TEST_ASSERT(taskSystem.Post([&executed] { ++executed; }));
+    taskSystem.WaitIdle();
+    TEST_ASSERT(1000 == executed);
+}
+
+template<class TaskSystemT>
+void Test_DelayedTaskIsExecuted(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    using ClockType = std::chrono::steady_clock;
+    constexpr auto delay = std::chrono::milliseconds{ 20 };
+
+    std::promise<ClockType::time_point> fired;
+    std::atomic<bool> isCancelledFired{ false };
+
+    const auto start = ClockType::now();
+    taskSystem.ScheduleAfter(delay, [&fired] { fired.set_value(ClockType::now()); });
+    const auto cancelled = taskSystem.ScheduleAt(start + delay/2, [&isCancelledFired] { isCancelledFired = true; });
+    TEST_ASSERT(taskSystem.CancelTimer(cancelled));
+    TEST_ASSERT(!taskSystem.CancelTimer(cancelled));
+
+    TEST_ASSERT(fired.get_future().get() - start >= delay);
+    TEST_ASSERT(!isCancelledFired);
+}
+
+template<class TaskSystemT>
+void Test_PeriodicTaskIsRepeated(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t repeatCount = 5;
+
+    std::atomic<size_t> executed{ 0 };
+    std::promise<void> done;
+    const auto timer = taskSystem.SchedulePeriodic(std::chrono::milliseconds{ 2 }, [&executed, &done] {
+        if (++executed == repeatCount)
+            done.set_value();
+    });
+
+    done.get_future().wait();
+    TEST_ASSERT(taskSystem.CancelTimer(timer));
+    taskSystem.WaitIdle();
+
+    const auto executedAfterCancel = executed.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+    TEST_ASSERT(executedAfterCancel == executed);
+}
+
+#ifdef THREAD_POOL_COROUTINES
+template<class TaskSystemT>
+CoroutineTask<size_t> IncrementOnPool(TaskSystemT& taskSystem, size_t value)
+{
+    const auto result = co_await taskSystem.ExecuteAsync([value] { return value + 1; });
+    co_return result;
 }
 
+template<class TaskSystemT>
+CoroutineTask<size_t> ComputeOnPool(TaskSystemT& taskSystem, std::thread::id callerId, bool& isOnPool)
+{
+    co_await taskSystem.Schedule();
+    isOnPool = std::this_thread::get_id() != callerId;
+    co_return co_await IncrementOnPool(taskSystem, 41);
+}
+
+template<class TaskSystemT>
+CoroutineTask<size_t> ThrowOnPool(TaskSystemT& taskSystem)
+{
+    co_await taskSystem.Schedule();
+    throw std::logic_error("coroutine failed");
+}
+
+template<class TaskSystemT>
+void Test_CoroutinesRunOnPool(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    bool isOnPool = false;
+    TEST_ASSERT(42 == Spawn(taskSystem, ComputeOnPool(taskSystem, std::this_thread::get_id(), isOnPool)).get());
+    TEST_ASSERT(isOnPool);
+
+    auto result = Spawn(taskSystem, ThrowOnPool(taskSystem));
+    try
+    {
+        result.get();
+    }
+    catch (const std::logic_error&)
+    {
+        return;
+    }
+    TEST_ASSERT(false && "exception was not propagated");
+}
+
+// Suspended coroutines do not hold workers, so thousands of them run on two workers.
+template<class TaskSystemT>
+void Test_ManyCoroutinesShareWorkers()
+{
+    constexpr size_t coroutineCount = 10000;
+
+    TaskSystemT taskSystem{ ThreadPoolOptions{ 2 } };
+
+    std::vector<Future<size_t>> results;
+    for (size_t i = 0; i < coroutineCount; ++i)
+        results.push_back(Spawn(taskSystem, IncrementOnPool(taskSystem, i)));
+
+    for (size_t i = 0; i < coroutineCount; ++i)
+        TEST_ASSERT(i + 1 == results[i].get());
+}
+#endif
+
 template<class TaskSystemT>
 void Test_RandomTaskExecutionTime(TaskSystemT&& taskSystem = TaskSystemT{})
 {
     constexpr size_t taskCount = 10000;
 
-    std::vector<std::future<void>> results;
+    std::vector<Future<void>> results;
 
     for (size_t i = 0; i < taskCount; ++i)
         results.push_back(taskSystem.ExecuteAsync(LoadCPUForRandomTime));
@@ -42,7 +1064,7 @@ void Test_1nsTaskExecutionTime(TaskSystemT&& taskSystem = TaskSystemT{})
 
     constexpr size_t taskCount = 10000;
 
-    std::vector<std::future<void>> results;
+    std::vector<Future<void>> results;
 
     for (size_t i = 0; i < taskCount; ++i)
         results.push_back(taskSystem.ExecuteAsync([] { LoadCPUFor(1ns); }));
@@ -58,7 +1080,7 @@ void Test_100msTaskExecutionTime(TaskSystemT&& taskSystem = TaskSystemT{})
 
     constexpr size_t taskCount = 10;
 
-    std::vector<std::future<void>> results;
+    std::vector<Future<void>> results;
 
     for (size_t i = 0; i < taskCount; ++i)
         results.push_back(taskSystem.ExecuteAsync([] { LoadCPUFor(100ms); }));
@@ -72,7 +1094,7 @@ void Test_EmptyTask(TaskSystemT&& taskSystem = TaskSystemT{})
 {
     constexpr size_t taskCount = 10000;
 
-    std::vector<std::future<void>> results;
+    std::vector<Future<void>> results;
 
     for (size_t i = 0; i < taskCount; ++i)
         results.push_back(taskSystem.ExecuteAsync([] {}));
@@ -81,10 +1103,22 @@ void Test_EmptyTask(TaskSystemT&& taskSystem = TaskSystemT{})
         result.wait();
 }
 
+template<class TaskSystemT>
+void Test_EmptyTaskBatch(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 10000;
+
+    const auto emptyTask = [] {};
+    const std::vector<std::decay_t<decltype(emptyTask)>> tasks(taskCount, emptyTask);
+
+    for (auto& result : taskSystem.ExecuteBatch(tasks.begin(), tasks.end()))
+        result.wait();
+}
+
 template<class TaskSystemT, class TaskT>
 void RepeatTask(TaskSystemT&& taskSystem, TaskT&& task, size_t times)
 {
-    std::vector<std::future<void>> results;
+    std::vector<Future<void>> results;
 
     // Here we need not to std::forward just copy task.
     // Because if the universal reference of task has bound to an r-value reference 
@@ -97,6 +1131,41 @@ void RepeatTask(TaskSystemT&& taskSystem, TaskT&& task, size_t times)
         result.wait();
 }
 
+template<class TaskSystemT>
+void Test_TaskGraphReruns(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t runCount = 1000;
+    constexpr size_t layerCount = 4;
+    constexpr size_t layerWidth = 8;
+
+    // Layers of nodes, every node depends on all nodes of the previous layer.
+    TaskGraph graph;
+    std::vector<TaskGraph::NodeId> previousLayer;
+    for (size_t layer = 0; layer < layerCount; ++layer)
+    {
+        std::vector<TaskGraph::NodeId> currentLayer;
+        for (size_t n = 0; n < layerWidth; ++n)
+        {
+            currentLayer.push_back(graph.AddNode([] {}));
+            for (const auto dependency : previousLayer)
+                graph.AddEdge(dependency, currentLayer.back());
+        }
+        previousLayer = std::move(currentLayer);
+    }
+
+    for (size_t n = 0; n < runCount; ++n)
+        graph.Run(taskSystem);
+}
+
+template<class TaskSystemT>
+void Test_ParallelForSmallElements(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t elementCount = 1000000;
+
+    std::vector<double> values(elementCount, 1.0);
+    ParallelFor(taskSystem, values, [](double& value) { value = std::sqrt(value + 1.0); });
+}
+
 template<class TaskSystemT>
 void Test_MultipleTaskProducers(TaskSystemT&& taskSystem = TaskSystemT{})
 {
@@ -114,8 +1183,305 @@ void Test_MultipleTaskProducers(TaskSystemT&& taskSystem = TaskSystemT{})
     }
 }
 
-int main()
+// boost::asio pool with io_context per worker, performance tests compare it with the shared io_context.
+class AsioContextPerThreadPool : public AsioThreadPool
+{
+public:
+    AsioContextPerThreadPool() : AsioThreadPool{ GetOptions() } {}
+
+private:
+    static ThreadPoolOptions GetOptions()
+    {
+        ThreadPoolOptions options{ std::max(2u, std::thread::hardware_concurrency()) };
+        options.ioContextPerThread = true;
+        return options;
+    }
+};
+
+// Multiple queue pool with power of two choices queue selection, performance tests compare it with round robin.
+class MultiQueueTwoChoicesPool : public MultiQueueThreadPool
+{
+public:
+    MultiQueueTwoChoicesPool() : MultiQueueThreadPool{ GetOptions() } {}
+
+private:
+    static ThreadPoolOptions GetOptions()
+    {
+        ThreadPoolOptions options;
+        options.queueSelection = QueueSelection::TwoChoices;
+        return options;
+    }
+};
+
+/** Timestamps of a task of latency tests (ns of steady clock). */
+struct TaskTimestamps
+{
+    uint64_t submitTime{ 0 }; // Intended arrival time for open loop
+    uint64_t startTime{ 0 };
+    uint64_t endTime{ 0 };
+};
+
+struct TaskLatencies
+{
+    HdrHistogram queueing;   // From submission to start
+    HdrHistogram completion; // From submission to completion
+};
+
+inline uint64_t GetLatencyClock()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+constexpr std::chrono::microseconds LatencyTaskDuration{ 10 };
+
+inline auto MakeTimestampedTask(TaskTimestamps& timestamps)
+{
+    return [&timestamps] {
+        timestamps.startTime = GetLatencyClock();
+        LoadCPUFor(LatencyTaskDuration);
+        timestamps.endTime = GetLatencyClock();
+    };
+}
+
+inline void AddLatencies(TaskLatencies& latencies, const std::vector<TaskTimestamps>& timestamps)
+{
+    for (const auto& task : timestamps)
+    {
+        latencies.queueing.Record(task.startTime > task.submitTime ? task.startTime - task.submitTime : 0);
+        latencies.completion.Record(task.endTime > task.submitTime ? task.endTime - task.submitTime : 0);
+    }
+}
+
+// Open loop: tasks arrive as Poisson process at LoadPercent of the pool capacity (one worker per core)
+// regardless of completion of previous tasks.
+// Latency is counted from the intended arrival time, so a late producer does not hide queueing (coordinated omission).
+template<class TaskSystemT, size_t LoadPercent>
+TaskLatencies Test_OpenLoopLatency(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 10000;
+
+    const auto capacity = std::max(1u, std::thread::hardware_concurrency())/std::chrono::duration<double, std::nano>(LatencyTaskDuration).count();
+    std::exponential_distribution<double> intervals{ capacity*LoadPercent/100 };
+    std::mt19937 random{ 0 }; // Arrivals should be identical
+
+    std::vector<TaskTimestamps> timestamps(taskCount);
+    std::vector<Future<void>> results;
+    results.reserve(taskCount);
+
+    auto arrivalTime = static_cast<double>(GetLatencyClock());
+    for (auto& task : timestamps)
+    {
+        arrivalTime += intervals(random);
+        task.submitTime = static_cast<uint64_t>(arrivalTime);
+        while (GetLatencyClock() < task.submitTime)
+            std::this_thread::yield();
+        results.push_back(taskSystem.ExecuteAsync(MakeTimestampedTask(task)));
+    }
+
+    for (auto& result : results)
+        result.wait();
+
+    TaskLatencies latencies;
+    AddLatencies(latencies, timestamps);
+    return latencies;
+}
+
+// Closed loop: one producer per core, every producer submits the next task when the previous one is completed.
+template<class TaskSystemT>
+TaskLatencies Test_ClosedLoopLatency(TaskSystemT&& taskSystem = TaskSystemT{})
+{
+    constexpr size_t taskCount = 1000; // Per producer
+
+    std::vector<std::vector<TaskTimestamps>> timestamps(std::max(1u, std::thread::hardware_concurrency()), std::vector<TaskTimestamps>(taskCount));
+    std::vector<std::thread> producers;
+
+    for (auto& producerTimestamps : timestamps)
+    {
+        producers.emplace_back([&taskSystem, &producerTimestamps] {
+            for (auto& task : producerTimestamps)
+            {
+                task.submitTime = GetLatencyClock();
+                taskSystem.ExecuteAsync(MakeTimestampedTask(task)).wait();
+            }
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    TaskLatencies latencies;
+    for (const auto& producerTimestamps : timestamps)
+        AddLatencies(latencies, producerTimestamps);
+    return latencies;
+}
+
+inline void PrintLatencies(const char* name, const char* description, const TaskLatencies& latencies)
+{
+    const auto print = [](const char* title, const HdrHistogram& histogram) {
+        std::cout << title << " p50 " << Benchmark::FormatTime(static_cast<double>(histogram.GetPercentile(0.5)))
+            << ", p99 " << Benchmark::FormatTime(static_cast<double>(histogram.GetPercentile(0.99)))
+            << ", p99.9 " << Benchmark::FormatTime(static_cast<double>(histogram.GetPercentile(0.999)))
+            << ", max " << Benchmark::FormatTime(static_cast<double>(histogram.GetMax()));
+    };
+
+    std::cout << " - Latency test ( " << name << ", description: " << description << " ) => ";
+    print("queueing", latencies.queueing);
+    print("; completion", latencies.completion);
+    std::cout << " (" << latencies.queueing.GetCount() << " tasks)" << std::endl;
+}
+
+// Test is a function returning TaskLatencies (template arguments may contain commas).
+#define DO_LATENCY_TEST(description, ...) \
+PrintLatencies(#__VA_ARGS__, description, __VA_ARGS__())
+
+constexpr int ScalingSkew = 8;
+
+/** A point of the scaling matrix: producers submit tasks to the pool of workerCount workers. */
+struct ScalingPoint
+{
+    size_t producerCount{ 1 };
+    size_t workerCount{ 1 };
+    std::chrono::nanoseconds taskDuration{ 0 };
+    bool isSkewed{ false }; // Random 1/ScalingSkew of tasks take ScalingSkew times longer, the other ones are empty (the same mean duration)
+    double throughput{ 0 }; // Tasks per second
+};
+
+// 1, 2, 4, ... and the number of cores.
+inline std::vector<size_t> GetScalingCounts()
+{
+    const size_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<size_t> counts;
+    for (size_t count = 1; count < coreCount; count *= 2)
+        counts.push_back(count);
+    counts.push_back(coreCount);
+    return counts;
+}
+
+template<class TaskSystemT>
+void MeasureThroughput(ScalingPoint& point)
+{
+    using namespace std::chrono_literals;
+
+    constexpr size_t taskCount = 2000;
+
+    TaskSystemT taskSystem{ ThreadPoolOptions{ point.workerCount } };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> producers;
+    for (size_t producer = 0; producer != point.producerCount; ++producer)
+    {
+        producers.emplace_back([&point, &taskSystem, producer] {
+            std::mt19937 random{ static_cast<unsigned>(producer) };
+            std::vector<Future<void>> results;
+
+            for (auto task = producer; task < taskCount; task += point.producerCount)
+            {
+                auto duration = point.taskDuration;
+                if (point.isSkewed)
+                    duration = random() % ScalingSkew == 0 ? duration*ScalingSkew : 0ns;
+
+                results.push_back(taskSystem.ExecuteAsync([duration] {
+                    if (duration != 0ns)
+                        LoadCPUFor(duration);
+                }));
+            }
+
+            for (auto& result : results)
+                result.wait();
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    point.throughput = taskCount/std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Throughput of the pool for every producer count, worker count, task duration (from empty to 100 us) and distribution.
+// Contention of queues shows up as throughput which drops with more producers or workers.
+template<class TaskSystemT>
+std::vector<ScalingPoint> Test_ScalingMatrix()
+{
+    using namespace std::chrono_literals;
+
+    std::vector<ScalingPoint> points;
+    for (const auto taskDuration : { 0ns, 1000ns, 10000ns, 100000ns })
+    {
+        for (const auto isSkewed : { false, true })
+        {
+            if (isSkewed && taskDuration == 0ns)
+                continue;
+
+            for (const auto producerCount : GetScalingCounts())
+            {
+                for (const auto workerCount : GetScalingCounts())
+                {
+                    points.push_back(ScalingPoint{ producerCount, workerCount, taskDuration, isSkewed });
+                    MeasureThroughput<TaskSystemT>(points.back());
+                }
+            }
+        }
+    }
+    return points;
+}
+
+// Table row is a throughput curve over worker counts.
+inline void PrintScalingMatrix(const char* name, const char* description, const std::vector<ScalingPoint>& points, std::ostream* csv)
+{
+    const auto workerCounts = GetScalingCounts();
+
+    std::cout << " - Scaling test ( " << name << ", description: " << description << " ) => tasks/s" << std::endl;
+    std::cout << "   " << std::left << std::setw(8) << "task" << std::setw(10) << "tasks" << std::setw(11) << "producers";
+    for (const auto workerCount : workerCounts)
+        std::cout << std::setw(12) << ("workers=" + std::to_string(workerCount));
+    std::cout << std::endl;
+
+    for (size_t index = 0; index < points.size(); index += workerCounts.size())
+    {
+        const auto& point = points[index];
+        const auto duration = point.taskDuration.count() == 0 ? std::string{ "empty" } : std::to_string(point.taskDuration.count()/1000) + " us";
+        std::cout << "   " << std::setw(8) << duration << std::setw(10) << (point.isSkewed ? "skewed" : "balanced") << std::setw(11) << point.producerCount;
+        for (size_t worker = 0; worker != workerCounts.size(); ++worker)
+        {
+            std::ostringstream throughput;
+            throughput << std::setprecision(3) << points[index + worker].throughput;
+            std::cout << std::setw(12) << throughput.str();
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::right;
+
+    if (csv)
+    {
+        for (const auto& point : points)
+        {
+            *csv << '"' << description << "\"," << (point.isSkewed ? "skewed" : "balanced") << ',' << point.taskDuration.count() << ','
+                << point.producerCount << ',' << point.workerCount << ',' << std::fixed << std::setprecision(0) << point.throughput << '\n';
+            csv->unsetf(std::ios::floatfield);
+        }
+    }
+}
+
+#define DO_SCALING_TEST(description, test, csv) \
+PrintScalingMatrix(#test, description, test(), csv)
+
+// "--trace file.json" writes Chrome trace of performance tests (see TaskTrace), "--scaling-csv file.csv" writes scaling matrix,
+// benchmark options are described in Benchmark.h.
+int main(int argc, char* argv[])
 {
+    std::string tracePath;
+    std::string scalingPath;
+    for (int index = 1; index + 1 < argc; ++index)
+    {
+        if (std::string{ argv[index] } == "--trace")
+            tracePath = argv[index + 1];
+        else if (std::string{ argv[index] } == "--scaling-csv")
+            scalingPath = argv[index + 1];
+    }
+    Benchmark::Get().ParseArguments(argc, argv);
+
     std::cout << "==========================================" << std::endl;
     std::cout << "             FUNCTIONAL TESTS             " << std::endl;
     std::cout << "==========================================" << std::endl;
@@ -125,6 +1491,194 @@ int main()
     DO_TEST(Test_TaskResultIsAsExpected<AsioThreadPool>);
 #ifdef _MSC_VER
     DO_TEST(Test_TaskResultIsAsExpected<PplThreadPool>);
+#endif
+    DO_TEST(Test_TaskExceptionIsPropagated<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskExceptionIsPropagated<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskExceptionIsPropagated<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskExceptionIsPropagated<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskExceptionIsPropagated<PplThreadPool>);
+#endif
+    DO_TEST(Test_TaskReferenceResultIsReturned<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskReferenceResultIsReturned<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskReferenceResultIsReturned<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskReferenceResultIsReturned<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskReferenceResultIsReturned<PplThreadPool>);
+#endif
+    DO_TEST(Test_BrokenPromiseIsReported);
+    DO_TEST(Test_TaskBatchResultIsAsExpected<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskBatchResultIsAsExpected<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskBatchResultIsAsExpected<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskBatchResultIsAsExpected<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskBatchResultIsAsExpected<PplThreadPool>);
+#endif
+    DO_TEST(Test_PostedTasksAreExecuted<SingleQueueThreadPool>);
+    DO_TEST(Test_PostedTasksAreExecuted<MultiQueueThreadPool>);
+    DO_TEST(Test_PostedTasksAreExecuted<WorkStealingThreadPool>);
+    DO_TEST(Test_PostedTasksAreExecuted<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_PostedTasksAreExecuted<PplThreadPool>);
+#endif
+    DO_TEST(Test_TaskWithLargeCaptureIsExecuted<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskWithLargeCaptureIsExecuted<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskWithLargeCaptureIsExecuted<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskWithLargeCaptureIsExecuted<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskWithLargeCaptureIsExecuted<PplThreadPool>);
+#endif
+    DO_TEST(Test_NestedTasksAreExecuted<SingleQueueThreadPool>);
+    DO_TEST(Test_NestedTasksAreExecuted<MultiQueueThreadPool>);
+    DO_TEST(Test_NestedTasksAreExecuted<WorkStealingThreadPool>);
+    DO_TEST(Test_NestedTasksAreExecuted<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_NestedTasksAreExecuted<PplThreadPool>);
+#endif
+    DO_TEST(Test_ContinuationsAreExecuted<SingleQueueThreadPool>);
+    DO_TEST(Test_ContinuationsAreExecuted<MultiQueueThreadPool>);
+    DO_TEST(Test_ContinuationsAreExecuted<WorkStealingThreadPool>);
+    DO_TEST(Test_ContinuationsAreExecuted<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_ContinuationsAreExecuted<PplThreadPool>);
+#endif
+    DO_TEST(Test_WhenAllIsReadyWhenAllTasksAreDone<SingleQueueThreadPool>);
+    DO_TEST(Test_WhenAllIsReadyWhenAllTasksAreDone<MultiQueueThreadPool>);
+    DO_TEST(Test_WhenAllIsReadyWhenAllTasksAreDone<WorkStealingThreadPool>);
+    DO_TEST(Test_WhenAllIsReadyWhenAllTasksAreDone<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_WhenAllIsReadyWhenAllTasksAreDone<PplThreadPool>);
+#endif
+    DO_TEST(Test_WhenAnyIsReadyWhenFirstTaskIsDone<SingleQueueThreadPool>);
+    DO_TEST(Test_WhenAnyIsReadyWhenFirstTaskIsDone<MultiQueueThreadPool>);
+    DO_TEST(Test_WhenAnyIsReadyWhenFirstTaskIsDone<WorkStealingThreadPool>);
+    DO_TEST(Test_WhenAnyIsReadyWhenFirstTaskIsDone<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_WhenAnyIsReadyWhenFirstTaskIsDone<PplThreadPool>);
+#endif
+    DO_TEST(Test_ContinuationAfterWhenAnyRacesWithCompletion<SingleQueueThreadPool>);
+    DO_TEST(Test_ContinuationAfterWhenAnyRacesWithCompletion<MultiQueueThreadPool>);
+    DO_TEST(Test_ContinuationAfterWhenAnyRacesWithCompletion<WorkStealingThreadPool>);
+    DO_TEST(Test_ContinuationAfterWhenAnyRacesWithCompletion<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_ContinuationAfterWhenAnyRacesWithCompletion<PplThreadPool>);
+#endif
+    DO_TEST(Test_TaskGraphResultIsAsExpected<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskGraphResultIsAsExpected<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskGraphResultIsAsExpected<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskGraphResultIsAsExpected<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskGraphResultIsAsExpected<PplThreadPool>);
+#endif
+    DO_TEST(Test_ParallelForProcessesAllElements<SingleQueueThreadPool>);
+    DO_TEST(Test_ParallelForProcessesAllElements<MultiQueueThreadPool>);
+    DO_TEST(Test_ParallelForProcessesAllElements<WorkStealingThreadPool>);
+    DO_TEST(Test_ParallelForProcessesAllElements<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_ParallelForProcessesAllElements<PplThreadPool>);
+#endif
+    DO_TEST(Test_ParallelReduceResultIsAsExpected<SingleQueueThreadPool>);
+    DO_TEST(Test_ParallelReduceResultIsAsExpected<MultiQueueThreadPool>);
+    DO_TEST(Test_ParallelReduceResultIsAsExpected<WorkStealingThreadPool>);
+    DO_TEST(Test_ParallelReduceResultIsAsExpected<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_ParallelReduceResultIsAsExpected<PplThreadPool>);
+#endif
+    DO_TEST(Test_CpuTopologyIsDetected);
+    DO_TEST(Test_PinnedWorkersExecuteTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_PinnedWorkersExecuteTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_PinnedWorkersExecuteTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_PinnedWorkersExecuteTasks<AsioThreadPool>);
+    DO_TEST(Test_WaitPolicyDoesNotLoseTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_WaitPolicyDoesNotLoseTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_WaitPolicyDoesNotLoseTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_HighPriorityTaskIsExecutedFirst<SingleQueueThreadPool>);
+    DO_TEST(Test_HighPriorityTaskIsExecutedFirst<MultiQueueThreadPool>);
+    DO_TEST(Test_HighPriorityTaskIsExecutedFirst<WorkStealingThreadPool>);
+    DO_TEST(Test_BoundedQueueAppliesAdmissionPolicy<SingleQueueThreadPool>);
+    DO_TEST(Test_BoundedQueueAppliesAdmissionPolicy<MultiQueueThreadPool>);
+    DO_TEST(Test_BoundedQueueAppliesAdmissionPolicy<WorkStealingThreadPool>);
+    DO_TEST(Test_WorkerBlocksOnFullQueueOfAnotherPool<SingleQueueThreadPool>);
+    DO_TEST(Test_WorkerBlocksOnFullQueueOfAnotherPool<MultiQueueThreadPool>);
+    DO_TEST(Test_WorkerBlocksOnFullQueueOfAnotherPool<WorkStealingThreadPool>);
+    DO_TEST(Test_WaitIdleWaitsForNestedTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_WaitIdleWaitsForNestedTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_WaitIdleWaitsForNestedTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_WaitIdleWaitsForNestedTasks<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_WaitIdleWaitsForNestedTasks<PplThreadPool>);
+#endif
+    DO_TEST(Test_TaskGroupWaitsForItsTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskGroupWaitsForItsTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskGroupWaitsForItsTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskGroupWaitsForItsTasks<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskGroupWaitsForItsTasks<PplThreadPool>);
+#endif
+    DO_TEST(Test_TaskGroupIsDestroyedRightAfterLastTask<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskGroupIsDestroyedRightAfterLastTask<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskGroupIsDestroyedRightAfterLastTask<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskGroupIsDestroyedRightAfterLastTask<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_TaskGroupIsDestroyedRightAfterLastTask<PplThreadPool>);
+#endif
+    DO_TEST(Test_ShutdownDrainExecutesQueuedTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_ShutdownDrainExecutesQueuedTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_ShutdownDrainExecutesQueuedTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_ShutdownDrainExecutesQueuedTasks<AsioThreadPool>);
+    DO_TEST(Test_ElasticPoolGrowsAndShrinks<SingleQueueThreadPool>);
+    DO_TEST(Test_ElasticPoolGrowsAndShrinks<MultiQueueThreadPool>);
+    DO_TEST(Test_ElasticPoolGrowsAndShrinks<WorkStealingThreadPool>);
+    DO_TEST(Test_StatsCountExecutedTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_StatsCountExecutedTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_StatsCountExecutedTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_StatsCountExecutedTasks<AsioThreadPool>);
+    DO_TEST(Test_TaskTraceRecordsTasks<SingleQueueThreadPool>);
+    DO_TEST(Test_TaskTraceRecordsTasks<MultiQueueThreadPool>);
+    DO_TEST(Test_TaskTraceRecordsTasks<WorkStealingThreadPool>);
+    DO_TEST(Test_TaskTraceRecordsTasks<AsioThreadPool>);
+    DO_TEST(Test_CancelledTasksAreSkipped<SingleQueueThreadPool>);
+    DO_TEST(Test_CancelledTasksAreSkipped<MultiQueueThreadPool>);
+    DO_TEST(Test_CancelledTasksAreSkipped<WorkStealingThreadPool>);
+    DO_TEST(Test_CancelledTasksAreSkipped<AsioThreadPool>);
+    DO_TEST(Test_StrandExecutesTasksInOrder<SingleQueueThreadPool>);
+    DO_TEST(Test_StrandExecutesTasksInOrder<MultiQueueThreadPool>);
+    DO_TEST(Test_StrandExecutesTasksInOrder<WorkStealingThreadPool>);
+    DO_TEST(Test_StrandExecutesTasksInOrder<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_StrandExecutesTasksInOrder<PplThreadPool>);
+#endif
+    DO_TEST(Test_KeyedTasksAreExecutedInOrder<0>);
+    DO_TEST(Test_KeyedTasksAreExecutedInOrder<1>);
+    DO_TEST(Test_TwoChoicesSelectShorterQueue);
+    DO_TEST(Test_AsioKeyedTasksAreExecutedInOrder<false>);
+    DO_TEST(Test_AsioKeyedTasksAreExecutedInOrder<true>);
+    DO_TEST(Test_DelayedTaskIsExecuted<SingleQueueThreadPool>);
+    DO_TEST(Test_DelayedTaskIsExecuted<MultiQueueThreadPool>);
+    DO_TEST(Test_DelayedTaskIsExecuted<WorkStealingThreadPool>);
+    DO_TEST(Test_DelayedTaskIsExecuted<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_DelayedTaskIsExecuted<PplThreadPool>);
+#endif
+    DO_TEST(Test_PeriodicTaskIsRepeated<SingleQueueThreadPool>);
+    DO_TEST(Test_PeriodicTaskIsRepeated<MultiQueueThreadPool>);
+    DO_TEST(Test_PeriodicTaskIsRepeated<WorkStealingThreadPool>);
+    DO_TEST(Test_PeriodicTaskIsRepeated<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_PeriodicTaskIsRepeated<PplThreadPool>);
+#endif
+#ifdef THREAD_POOL_COROUTINES
+    DO_TEST(Test_CoroutinesRunOnPool<SingleQueueThreadPool>);
+    DO_TEST(Test_CoroutinesRunOnPool<MultiQueueThreadPool>);
+    DO_TEST(Test_CoroutinesRunOnPool<WorkStealingThreadPool>);
+    DO_TEST(Test_CoroutinesRunOnPool<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_TEST(Test_CoroutinesRunOnPool<PplThreadPool>);
+#endif
+    DO_TEST(Test_ManyCoroutinesShareWorkers<SingleQueueThreadPool>);
+    DO_TEST(Test_ManyCoroutinesShareWorkers<MultiQueueThreadPool>);
+    DO_TEST(Test_ManyCoroutinesShareWorkers<WorkStealingThreadPool>);
+    DO_TEST(Test_ManyCoroutinesShareWorkers<AsioThreadPool>);
 #endif
     std::cout << std::endl;
 
@@ -134,8 +1688,13 @@ int main()
     std::cout << "Number of cores: " << std::thread::hardware_concurrency() << std::endl;
     constexpr size_t NumOfRuns = 10;
     std::cout << std::endl;
+
+    // Every pool of every run has own threads, so only the latest events of each thread are kept.
+    if (!tracePath.empty())
+        TaskTrace::Get().Start(1 << 12);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on single task queue ", NumOfRuns, Test_RandomTaskExecutionTime<SingleQueueThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues", NumOfRuns, Test_RandomTaskExecutionTime<MultiQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues (two choices)", NumOfRuns, Test_RandomTaskExecutionTime<MultiQueueTwoChoicesPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on work stealing queue ", NumOfRuns, Test_RandomTaskExecutionTime<WorkStealingThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio", NumOfRuns, Test_RandomTaskExecutionTime<AsioThreadPool>);
 #ifdef _MSC_VER
@@ -165,19 +1724,106 @@ int main()
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues", NumOfRuns, Test_EmptyTask<MultiQueueThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on work stealing queue ", NumOfRuns, Test_EmptyTask<WorkStealingThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio", NumOfRuns, Test_EmptyTask<AsioThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio (io_context per thread)", NumOfRuns, Test_EmptyTask<AsioContextPerThreadPool>);
 #ifdef _MSC_VER
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on PPL", NumOfRuns, Test_EmptyTask<PplThreadPool>);
 #endif
     std::cout << std::endl;
 
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on single task queue ", NumOfRuns, Test_EmptyTaskBatch<SingleQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues", NumOfRuns, Test_EmptyTaskBatch<MultiQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on work stealing queue ", NumOfRuns, Test_EmptyTaskBatch<WorkStealingThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio", NumOfRuns, Test_EmptyTaskBatch<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on PPL", NumOfRuns, Test_EmptyTaskBatch<PplThreadPool>);
+#endif
+    std::cout << std::endl;
+
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on single task queue ", NumOfRuns, Test_MultipleTaskProducers<SingleQueueThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues", NumOfRuns, Test_MultipleTaskProducers<MultiQueueThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on work stealing queue ", NumOfRuns, Test_MultipleTaskProducers<WorkStealingThreadPool>);
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio", NumOfRuns, Test_MultipleTaskProducers<AsioThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio (io_context per thread)", NumOfRuns, Test_MultipleTaskProducers<AsioContextPerThreadPool>);
 #ifdef _MSC_VER
     DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on PPL", NumOfRuns, Test_MultipleTaskProducers<PplThreadPool>);
 #endif
     std::cout << std::endl;
 
-    return 0;
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on single task queue ", NumOfRuns, Test_TaskGraphReruns<SingleQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues", NumOfRuns, Test_TaskGraphReruns<MultiQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on work stealing queue ", NumOfRuns, Test_TaskGraphReruns<WorkStealingThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio", NumOfRuns, Test_TaskGraphReruns<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on PPL", NumOfRuns, Test_TaskGraphReruns<PplThreadPool>);
+#endif
+    std::cout << std::endl;
+
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on single task queue ", NumOfRuns, Test_ParallelForSmallElements<SingleQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on multiple task queues", NumOfRuns, Test_ParallelForSmallElements<MultiQueueThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on work stealing queue ", NumOfRuns, Test_ParallelForSmallElements<WorkStealingThreadPool>);
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on boost::asio", NumOfRuns, Test_ParallelForSmallElements<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_BENCHMARK_TEST_WITH_DESCRIPTION("thread pool based on PPL", NumOfRuns, Test_ParallelForSmallElements<PplThreadPool>);
+#endif
+    std::cout << std::endl;
+
+    if (!tracePath.empty())
+    {
+        TaskTrace::Get().Stop();
+        std::ofstream traceFile{ tracePath };
+        TaskTrace::Get().Write(traceFile);
+    }
+
+    std::cout << "==========================================" << std::endl;
+    std::cout << "              LATENCY TESTS               " << std::endl;
+    std::cout << "==========================================" << std::endl;
+    std::cout << "= Open loop (Poisson arrivals), 50% load =" << std::endl;
+    DO_LATENCY_TEST("thread pool based on single task queue ", Test_OpenLoopLatency<SingleQueueThreadPool, 50>);
+    DO_LATENCY_TEST("thread pool based on multiple task queues", Test_OpenLoopLatency<MultiQueueThreadPool, 50>);
+    DO_LATENCY_TEST("thread pool based on multiple task queues (two choices)", Test_OpenLoopLatency<MultiQueueTwoChoicesPool, 50>);
+    DO_LATENCY_TEST("thread pool based on work stealing queue ", Test_OpenLoopLatency<WorkStealingThreadPool, 50>);
+    DO_LATENCY_TEST("thread pool based on boost::asio", Test_OpenLoopLatency<AsioThreadPool, 50>);
+#ifdef _MSC_VER
+    DO_LATENCY_TEST("thread pool based on PPL", Test_OpenLoopLatency<PplThreadPool, 50>);
+#endif
+    std::cout << std::endl;
+
+    std::cout << "= Open loop (Poisson arrivals), 90% load =" << std::endl;
+    DO_LATENCY_TEST("thread pool based on single task queue ", Test_OpenLoopLatency<SingleQueueThreadPool, 90>);
+    DO_LATENCY_TEST("thread pool based on multiple task queues", Test_OpenLoopLatency<MultiQueueThreadPool, 90>);
+    DO_LATENCY_TEST("thread pool based on multiple task queues (two choices)", Test_OpenLoopLatency<MultiQueueTwoChoicesPool, 90>);
+    DO_LATENCY_TEST("thread pool based on work stealing queue ", Test_OpenLoopLatency<WorkStealingThreadPool, 90>);
+    DO_LATENCY_TEST("thread pool based on boost::asio", Test_OpenLoopLatency<AsioThreadPool, 90>);
+#ifdef _MSC_VER
+    DO_LATENCY_TEST("thread pool based on PPL", Test_OpenLoopLatency<PplThreadPool, 90>);
+#endif
+    std::cout << std::endl;
+
+    std::cout << "=   Closed loop, one producer per core   =" << std::endl;
+    DO_LATENCY_TEST("thread pool based on single task queue ", Test_ClosedLoopLatency<SingleQueueThreadPool>);
+    DO_LATENCY_TEST("thread pool based on multiple task queues", Test_ClosedLoopLatency<MultiQueueThreadPool>);
+    DO_LATENCY_TEST("thread pool based on work stealing queue ", Test_ClosedLoopLatency<WorkStealingThreadPool>);
+    DO_LATENCY_TEST("thread pool based on boost::asio", Test_ClosedLoopLatency<AsioThreadPool>);
+#ifdef _MSC_VER
+    DO_LATENCY_TEST("thread pool based on PPL", Test_ClosedLoopLatency<PplThreadPool>);
+#endif
+    std::cout << std::endl;
+
+    std::cout << "==========================================" << std::endl;
+    std::cout << "              SCALING TESTS               " << std::endl;
+    std::cout << "==========================================" << std::endl;
+    std::ofstream scalingFile;
+    if (!scalingPath.empty())
+    {
+        scalingFile.open(scalingPath);
+        scalingFile << "pool,distribution,task_ns,producers,workers,tasks_per_second\n";
+    }
+    auto* scalingCsv = scalingPath.empty() ? nullptr : &scalingFile;
+    DO_SCALING_TEST("thread pool based on single task queue ", Test_ScalingMatrix<SingleQueueThreadPool>, scalingCsv);
+    DO_SCALING_TEST("thread pool based on multiple task queues", Test_ScalingMatrix<MultiQueueThreadPool>, scalingCsv);
+    DO_SCALING_TEST("thread pool based on work stealing queue ", Test_ScalingMatrix<WorkStealingThreadPool>, scalingCsv);
+    DO_SCALING_TEST("thread pool based on boost::asio", Test_ScalingMatrix<AsioThreadPool>, scalingCsv);
+    std::cout << std::endl;
+
+    return Benchmark::Get().Finish() == 0 ? 0 : 1;
 }
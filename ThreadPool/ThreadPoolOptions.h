@@ -0,0 +1,140 @@
+#pragma once
+
+#include "CpuTopology.h"
+#include "TaskQueue.h"
+#include "Common/SpinWait.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+enum class ThreadAffinity
+{
+    None, // Workers are scheduled by OS
+    Core, // Every worker is pinned to one CPU
+    Node  // Worker may run on any CPU of its NUMA node
+};
+
+enum class ShutdownMode
+{
+    Drain,  // Queued tasks (and tasks they post) are executed before workers are stopped
+    Discard // Workers finish current tasks, queued tasks are dropped (their futures get broken promise)
+};
+
+// How multiple queue pool picks the queue of a task (other pools have shared or stealing queues).
+enum class QueueSelection
+{
+    RoundRobin, // Next queue in turn (one shared counter)
+    TwoChoices  // Shorter of two random queues, so tasks do not pile up behind a long one
+};
+
+struct ThreadPoolOptions
+{
+    size_t threadCount{ std::max(1u, std::thread::hardware_concurrency()) };
+    // Workers are assigned to CPUs node by node, so neighbouring workers (and their queues) share a node.
+    ThreadAffinity affinity{ ThreadAffinity::None };
+    // How long idle worker spins before parking (boost::asio and PPL pools use their own waiting).
+    WaitPolicy waitPolicy;
+    // Lower priority task is popped after so many pops of higher priority ones (0 - strict priorities).
+    size_t priorityAgingLimit{ 64 };
+    // Capacity and watermarks of every task queue of the pool (unbounded by default, ignored by boost::asio and PPL pools).
+    TaskQueueLimits queueLimits;
+    // Queue of a normal or low priority task in multiple queue pool (high priority task goes to the shortest queue).
+    QueueSelection queueSelection{ QueueSelection::RoundRobin };
+    // Elastic pool runs from minThreadCount to threadCount workers depending on load (0 - fixed pool of threadCount workers).
+    size_t minThreadCount{ 0 };
+    // Extra worker retires after so long without tasks.
+    std::chrono::milliseconds idleTimeout{ 1000 };
+    // Backlog check period: a worker is added if tasks keep waiting for two periods.
+    std::chrono::milliseconds scaleInterval{ 10 };
+    // Tick of the timer wheel: delayed and periodic tasks are late at most by so much.
+    std::chrono::milliseconds timerResolution{ 1 };
+    // boost::asio pool runs one io_context per worker (tasks are spread round robin) instead of one shared by all workers.
+    bool ioContextPerThread{ false };
+};
+
+namespace detail
+{
+    /** The WorkerPlacement class maps workers of a pool to CPUs and NUMA nodes.
+    * Without affinity all workers belong to node 0, so node-aware logic of the pools degrades to plain round robin.
+    */
+    class WorkerPlacement
+    {
+    public:
+        WorkerPlacement(size_t threadCount, ThreadAffinity affinity)
+            : m_affinity{ affinity }
+            , m_workerNodes(threadCount, 0)
+            , m_nodeWorkers(1)
+        {
+            if (m_affinity != ThreadAffinity::None)
+            {
+                const auto& topology = CpuTopology::Get();
+                const auto& cpus = topology.GetCpus();
+
+                m_nodeWorkers.resize(topology.GetNodeCount());
+                for (size_t worker = 0; worker != threadCount; ++worker)
+                {
+                    const auto cpu = cpus[worker % cpus.size()];
+                    m_workerCpus.push_back(cpu);
+                    m_workerNodes[worker] = topology.GetCpuNode(cpu);
+                }
+            }
+
+            for (size_t worker = 0; worker != threadCount; ++worker)
+                m_nodeWorkers[m_workerNodes[worker]].push_back(worker);
+
+            m_nodeWorkers.erase(std::remove_if(m_nodeWorkers.begin(), m_nodeWorkers.end(), [](const auto& workers) { return workers.empty(); }), m_nodeWorkers.end());
+
+            m_workerGroups.resize(threadCount);
+            for (size_t group = 0; group != m_nodeWorkers.size(); ++group)
+            {
+                for (const auto worker : m_nodeWorkers[group])
+                    m_workerGroups[worker] = group;
+            }
+        }
+
+        // Is called by the worker thread itself.
+        void Apply(size_t worker) const
+        {
+            if (m_affinity == ThreadAffinity::Core)
+                SetCurrentThreadAffinity({ m_workerCpus[worker] });
+            else if (m_affinity == ThreadAffinity::Node)
+                SetCurrentThreadAffinity(CpuTopology::Get().GetNodeCpus(m_workerNodes[worker]));
+        }
+
+        // Workers of the same node as the given worker (including it).
+        const std::vector<size_t>& GetNodeWorkers(size_t worker) const
+        {
+            return m_nodeWorkers[m_workerGroups[worker]];
+        }
+
+        // Other workers in stealing order: same node first, then other nodes (both in ring order after the worker).
+        std::vector<size_t> GetVictims(size_t worker) const
+        {
+            const auto workerCount = m_workerNodes.size();
+
+            std::vector<size_t> victims;
+            for (size_t n = 1; n != workerCount; ++n)
+            {
+                const auto victim = (worker + n) % workerCount;
+                if (m_workerNodes[victim] == m_workerNodes[worker])
+                    victims.push_back(victim);
+            }
+            for (size_t n = 1; n != workerCount; ++n)
+            {
+                const auto victim = (worker + n) % workerCount;
+                if (m_workerNodes[victim] != m_workerNodes[worker])
+                    victims.push_back(victim);
+            }
+            return victims;
+        }
+
+    private:
+        ThreadAffinity                   m_affinity;
+        std::vector<size_t>              m_workerCpus;
+        std::vector<size_t>              m_workerNodes;
+        std::vector<std::vector<size_t>> m_nodeWorkers;
+        std::vector<size_t>              m_workerGroups; // Index in m_nodeWorkers
+    };
+
+} // namespace detail
@@ -0,0 +1,314 @@
+#pragma once
+
+#include "TaskTrace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Runtime statistics of thread pools are collected unless THREAD_POOL_STATS is defined as 0
+// (then all counters compile to nothing and GetStats() reports only pool level counts).
+#ifndef THREAD_POOL_STATS
+#define THREAD_POOL_STATS 1
+#endif
+
+/** The LatencyHistogram struct counts latencies in log2 buckets: bucket n counts latencies in [2^n, 2^(n+1)) ns
+* (bucket 0 also counts zero ones, the last bucket counts everything above).
+*/
+struct LatencyHistogram
+{
+    static constexpr size_t BucketCount = 40;
+
+    std::array<uint64_t, BucketCount> buckets{};
+
+    uint64_t GetCount() const
+    {
+        uint64_t count = 0;
+        for (const auto bucket : buckets)
+            count += bucket;
+        return count;
+    }
+
+    // Upper bound of the bucket where the fraction (e.g. 0.99) of latencies is reached, zero if there are no latencies.
+    std::chrono::nanoseconds GetPercentile(double fraction) const
+    {
+        const auto count = GetCount();
+        if (count == 0)
+            return std::chrono::nanoseconds::zero();
+
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction*static_cast<double>(count))));
+        uint64_t seenCount = 0;
+        for (size_t bucket = 0; bucket != BucketCount; ++bucket)
+        {
+            seenCount += buckets[bucket];
+            if (seenCount >= rank)
+                return std::chrono::nanoseconds{ std::int64_t{ 2 } << bucket };
+        }
+        return std::chrono::nanoseconds{ std::int64_t{ 1 } << BucketCount };
+    }
+
+    LatencyHistogram& operator+=(const LatencyHistogram& other)
+    {
+        for (size_t bucket = 0; bucket != BucketCount; ++bucket)
+            buckets[bucket] += other.buckets[bucket];
+        return *this;
+    }
+};
+
+struct WorkerStats
+{
+    size_t queueSize{ 0 };                    // Tasks waiting in own queues of the worker (pools with per-worker queues)
+    uint64_t executedCount{ 0 };
+    uint64_t stealCount{ 0 };                 // Tasks taken from other workers (work stealing pool)
+    uint64_t failedStealCount{ 0 };           // Victims which had nothing to steal (or the race was lost)
+    uint64_t parkCount{ 0 };
+    std::chrono::nanoseconds busyTime{ 0 };   // Executing tasks
+    std::chrono::nanoseconds parkedTime{ 0 }; // Blocked waiting for tasks (spinning is not included)
+    LatencyHistogram queueLatency;            // From submission of a task to its start
+
+    WorkerStats& operator+=(const WorkerStats& other)
+    {
+        queueSize += other.queueSize;
+        executedCount += other.executedCount;
+        stealCount += other.stealCount;
+        failedStealCount += other.failedStealCount;
+        parkCount += other.parkCount;
+        busyTime += other.busyTime;
+        parkedTime += other.parkedTime;
+        queueLatency += other.queueLatency;
+        return *this;
+    }
+};
+
+/** Snapshot of thread pool statistics (see GetStats() of the pools). Counters are read without synchronization,
+* so the snapshot of a running pool is approximate.
+*/
+struct ThreadPoolStats
+{
+    size_t threadCount{ 0 };          // Current number of workers
+    size_t pendingCount{ 0 };         // Queued and running tasks (not known for PPL pool)
+    size_t queuedCount{ 0 };          // Tasks waiting in queues (not known for boost::asio and PPL pools)
+    std::vector<WorkerStats> workers; // Per worker slot, retired workers of elastic pool keep their counters
+
+    WorkerStats GetTotal() const
+    {
+        WorkerStats total;
+        for (const auto& worker : workers)
+            total += worker;
+        return total;
+    }
+};
+
+namespace detail
+{
+    constexpr bool StatsEnabled = THREAD_POOL_STATS != 0;
+
+    using StatsClock = std::chrono::steady_clock;
+
+    // Trace events are produced by the same instrumentation as statistics.
+    inline void Trace(TaskTrace::EventType type, uint64_t value = 0)
+    {
+        if constexpr (StatsEnabled)
+            TaskTrace::Record(type, value);
+    }
+
+    /** Statistics of one worker. Counters are written only by the worker thread (plain load and store, no atomic RMW),
+    * every worker has own cache lines, so collecting them does not add any contention to the hot path.
+    */
+    class alignas(64) WorkerCounters
+    {
+    public:
+        // Counters of the calling worker thread (nullptr for other threads).
+        static WorkerCounters* GetCurrent()
+        {
+            return t_current;
+        }
+
+        // Is called by the worker thread itself.
+        void MakeCurrent()
+        {
+            t_current = this;
+        }
+
+        // Returns start time of the task (for FinishTask).
+        StatsClock::time_point StartTask()
+        {
+            if constexpr (StatsEnabled)
+                m_taskStartTime = StatsClock::now();
+            return m_taskStartTime;
+        }
+
+        void FinishTask(StatsClock::time_point startTime)
+        {
+            if constexpr (StatsEnabled)
+            {
+                Add(m_executedCount, 1);
+                Add(m_busyTime, ToNanoseconds(StatsClock::now() - startTime));
+            }
+        }
+
+        // Latency is counted till the start of the current task, so a task executed in place by another task counts zero.
+        void AddLatency(StatsClock::time_point submitTime)
+        {
+            if constexpr (StatsEnabled)
+            {
+                const auto latency = m_taskStartTime > submitTime ? ToNanoseconds(m_taskStartTime - submitTime) : 0;
+                Add(m_latencies[GetBucket(latency)], 1);
+            }
+        }
+
+        void AddSteal(bool isStolen)
+        {
+            if constexpr (StatsEnabled)
+                Add(isStolen ? m_stealCount : m_failedStealCount, 1);
+        }
+
+        // Park time is reported to counters of the calling worker thread (if any), so queues do not know their consumers.
+        static StatsClock::time_point StartPark()
+        {
+            if constexpr (StatsEnabled)
+            {
+                if (t_current)
+                {
+                    Trace(TaskTrace::EventType::ParkBegin);
+                    return StatsClock::now();
+                }
+            }
+            return {};
+        }
+
+        static void FinishPark(StatsClock::time_point startTime)
+        {
+            if constexpr (StatsEnabled)
+            {
+                if (t_current && startTime != StatsClock::time_point{})
+                {
+                    Trace(TaskTrace::EventType::ParkEnd);
+                    Add(t_current->m_parkCount, 1);
+                    Add(t_current->m_parkedTime, ToNanoseconds(StatsClock::now() - startTime));
+                }
+            }
+        }
+
+        WorkerStats GetStats() const
+        {
+            WorkerStats stats;
+            stats.executedCount = m_executedCount.load(std::memory_order_relaxed);
+            stats.stealCount = m_stealCount.load(std::memory_order_relaxed);
+            stats.failedStealCount = m_failedStealCount.load(std::memory_order_relaxed);
+            stats.parkCount = m_parkCount.load(std::memory_order_relaxed);
+            stats.busyTime = std::chrono::nanoseconds{ static_cast<std::chrono::nanoseconds::rep>(m_busyTime.load(std::memory_order_relaxed)) };
+            stats.parkedTime = std::chrono::nanoseconds{ static_cast<std::chrono::nanoseconds::rep>(m_parkedTime.load(std::memory_order_relaxed)) };
+            for (size_t bucket = 0; bucket != LatencyHistogram::BucketCount; ++bucket)
+                stats.queueLatency.buckets[bucket] = m_latencies[bucket].load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        // Single writer: no need for (much more expensive) fetch_add.
+        static void Add(std::atomic<uint64_t>& counter, uint64_t value)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        static uint64_t ToNanoseconds(StatsClock::duration duration)
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+        }
+
+        static size_t GetBucket(uint64_t latency)
+        {
+            if (latency == 0)
+                return 0;
+#ifdef _MSC_VER
+            // _BitScanReverse64 is not available for x86.
+            unsigned long index = 0;
+            const auto high = static_cast<unsigned long>(latency >> 32);
+            size_t bucket = 0;
+            if (high != 0)
+            {
+                _BitScanReverse(&index, high);
+                bucket = index + 32;
+            }
+            else
+            {
+                _BitScanReverse(&index, static_cast<unsigned long>(latency));
+                bucket = index;
+            }
+#else
+            const auto bucket = static_cast<size_t>(63 - __builtin_clzll(latency));
+#endif
+            return std::min(bucket, LatencyHistogram::BucketCount - 1);
+        }
+
+        std::atomic<uint64_t> m_executedCount{ 0 };
+        std::atomic<uint64_t> m_stealCount{ 0 };
+        std::atomic<uint64_t> m_failedStealCount{ 0 };
+        std::atomic<uint64_t> m_parkCount{ 0 };
+        std::atomic<uint64_t> m_busyTime{ 0 };   // ns
+        std::atomic<uint64_t> m_parkedTime{ 0 }; // ns
+        std::array<std::atomic<uint64_t>, LatencyHistogram::BucketCount> m_latencies{};
+        StatsClock::time_point m_taskStartTime;
+
+        static thread_local WorkerCounters* t_current;
+    };
+
+    /** Task wrapper which remembers submission time, so the worker which starts it records queue latency.
+    * It also traces enqueue, start and end of the task (see TaskTrace).
+    */
+    template <typename FuncT>
+    class StampedTask
+    {
+    public:
+        template <typename F>
+        explicit StampedTask(F&& func)
+            : m_func(std::forward<F>(func))
+        {}
+
+        void operator()()
+        {
+            if (auto* counters = WorkerCounters::GetCurrent())
+                counters->AddLatency(m_submitTime);
+
+            Trace(TaskTrace::EventType::Start, m_traceId);
+            m_func();
+            Trace(TaskTrace::EventType::End, m_traceId);
+        }
+
+    private:
+        FuncT m_func;
+        StatsClock::time_point m_submitTime{ StatsClock::now() };
+        uint64_t m_traceId{ TaskTrace::RecordEnqueue() };
+    };
+
+    // Without statistics the task is passed as is.
+    template <typename FuncT>
+    auto StampTask(FuncT&& func)
+    {
+        if constexpr (StatsEnabled)
+            return StampedTask<std::decay_t<FuncT>>{ std::forward<FuncT>(func) };
+        else
+            return std::decay_t<FuncT>(std::forward<FuncT>(func));
+    }
+
+    // Worker part of pool statistics (pool fills its own counts).
+    inline ThreadPoolStats CollectStats(const std::vector<WorkerCounters>& counters)
+    {
+        ThreadPoolStats stats;
+        for (const auto& worker : counters)
+            stats.workers.push_back(worker.GetStats());
+        return stats;
+    }
+
+} // namespace detail
+
+thread_local detail::WorkerCounters* detail::WorkerCounters::t_current{ nullptr };
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "Future.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/** Identifies a timer of TimerWheel (e.g. to cancel it). Ids of fired and cancelled timers are never reused. */
+struct TimerId
+{
+    uint32_t index{ static_cast<uint32_t>(-1) };
+    uint32_t generation{ 0 };
+
+    bool IsValid() const
+    {
+        return index != static_cast<uint32_t>(-1);
+    }
+};
+
+/** The TimerWheel class runs delayed and periodic tasks: expired tasks are posted to the executor (thread pool).
+* Timers are kept in hierarchical timing wheel: LevelCount levels of 64 slots, slot of level n covers 64^n ticks
+* (tick is the resolution), timers of upper levels are moved down when lower level completes its rotation.
+* - Insert and cancel are O(1): timer node is linked into the slot list, nodes are kept in one vector and reused,
+*   so in steady state timers do not allocate (tasks up to 64 bytes are stored in place).
+* - Timer thread is started by the first timer and sleeps until the next non-empty slot (or the end of rotation).
+* - Task never runs earlier than its time and is late at most by the resolution (plus wake up and queueing delay).
+* - Periodic task is not run concurrently with itself: a period is skipped if the previous run is not finished yet.
+*/
+class TimerWheel
+{
+public:
+    using ClockType = std::chrono::steady_clock;
+
+    explicit TimerWheel(const Executor& executor, ClockType::duration resolution = std::chrono::milliseconds{ 1 })
+        : m_executor{ executor }
+        , m_resolution{ std::max(resolution, ClockType::duration{ 1 }) }
+        , m_startTime{ ClockType::now() }
+        , m_slots(LevelCount*SlotCount, NoNode)
+    {}
+
+    ~TimerWheel()
+    {
+        Stop();
+    }
+
+    // Period of zero schedules one-shot timer. Returns invalid id if the wheel is stopped (task is dropped).
+    template <typename TaskT>
+    TimerId Schedule(ClockType::time_point time, ClockType::duration period, TaskT&& task)
+    {
+        const auto periodTicks = period > ClockType::duration::zero() ? std::max<uint64_t>(1, ToTicks(period)) : 0;
+
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        if (m_isStopped)
+            return TimerId{};
+
+        // Empty wheel is not advanced by timer thread, so it is moved to the current time here.
+        if (m_count == 0)
+            m_currentTick = std::max(m_currentTick, GetCurrentTick());
+
+        const auto index = AllocateNodeLocked();
+        auto& node = m_nodes[index];
+        node.expiryTick = std::max(GetTick(time), m_currentTick + 1);
+        node.periodTicks = periodTicks;
+        if (periodTicks == 0)
+            node.task = detail::MakeCallback(std::forward<TaskT>(task));
+        else
+            node.periodicTask = std::make_shared<PeriodicTask>(detail::MakeCallback(std::forward<TaskT>(task)));
+
+        InsertLocked(index);
+        ++m_count;
+
+        if (!m_thread.joinable())
+            m_thread = std::thread{ [this] { Run(); } };
+        else if (node.expiryTick < m_wakeTick)
+            m_condition.notify_one();
+
+        return TimerId{ index, node.generation };
+    }
+
+    // Returns false if the timer has already fired (one-shot), been cancelled or the id is invalid.
+    // Task which has already been posted to the executor is not affected.
+    bool Cancel(TimerId id)
+    {
+        Node node; // Task is destroyed without the lock, its destructor may use the wheel
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        if (id.index >= m_nodes.size() || m_nodes[id.index].generation != id.generation || m_nodes[id.index].slot == NoNode)
+            return false;
+
+        UnlinkLocked(id.index);
+        node.task = std::move(m_nodes[id.index].task);
+        node.periodicTask = std::move(m_nodes[id.index].periodicTask);
+        FreeNodeLocked(id.index);
+        --m_count;
+        return true;
+    }
+
+    // Number of scheduled timers.
+    size_t GetSize() const
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        return m_count;
+    }
+
+    // Stops timer thread, timers which have not fired are dropped.
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_isStopped = true;
+        }
+        m_condition.notify_one();
+
+        if (m_thread.joinable())
+            m_thread.join();
+
+        std::vector<Node> nodes; // Tasks are destroyed without the lock
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        nodes.swap(m_nodes);
+        std::fill(m_slots.begin(), m_slots.end(), NoNode);
+        std::fill(std::begin(m_occupiedSlots), std::end(m_occupiedSlots), uint64_t{ 0 });
+        m_freeNode = NoNode;
+        m_count = 0;
+    }
+
+private:
+    static constexpr size_t   SlotBits = 6;
+    static constexpr size_t   SlotCount = size_t{ 1 } << SlotBits;
+    static constexpr uint64_t SlotMask = SlotCount - 1;
+    static constexpr size_t   LevelCount = 6; // 2^36 ticks, about 2 years for 1 ms resolution
+    static constexpr uint32_t NoNode = static_cast<uint32_t>(-1);
+
+    struct PeriodicTask
+    {
+        explicit PeriodicTask(detail::Callback&& task) : task{ std::move(task) } {}
+
+        detail::Callback  task;
+        std::atomic<bool> isRunning{ false };
+    };
+
+    struct Node
+    {
+        uint32_t prev{ NoNode };
+        uint32_t next{ NoNode }; // Next node of the slot or of the free list
+        uint32_t slot{ NoNode }; // NoNode if the node is free
+        uint32_t generation{ 0 };
+        uint64_t expiryTick{ 0 };
+        uint64_t periodTicks{ 0 };
+        detail::Callback task;
+        std::shared_ptr<PeriodicTask> periodicTask;
+    };
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    uint64_t ToTicks(ClockType::duration duration) const
+    {
+        return static_cast<uint64_t>((duration + m_resolution - ClockType::duration{ 1 })/m_resolution);
+    }
+
+    // First tick at or after the time (so timers never fire early).
+    uint64_t GetTick(ClockType::time_point time) const
+    {
+        return time > m_startTime ? ToTicks(time - m_startTime) : 0;
+    }
+
+    uint64_t GetCurrentTick() const
+    {
+        return static_cast<uint64_t>((ClockType::now() - m_startTime)/m_resolution);
+    }
+
+    ClockType::time_point GetTickTime(uint64_t tick) const
+    {
+        return m_startTime + m_resolution*static_cast<ClockType::rep>(tick);
+    }
+
+    uint32_t AllocateNodeLocked()
+    {
+        if (m_freeNode == NoNode)
+        {
+            m_nodes.emplace_back();
+            return static_cast<uint32_t>(m_nodes.size() - 1);
+        }
+        return std::exchange(m_freeNode, m_nodes[m_freeNode].next);
+    }
+
+    void FreeNodeLocked(uint32_t index)
+    {
+        auto& node = m_nodes[index];
+        node.task = detail::Callback{};
+        node.periodicTask.reset();
+        node.slot = NoNode;
+        ++node.generation;
+        node.next = std::exchange(m_freeNode, index);
+    }
+
+    // Level is chosen by distance to expiry, so the timer reaches level 0 by cascading exactly in its tick.
+    void InsertLocked(uint32_t index)
+    {
+        auto& node = m_nodes[index];
+        const auto expiryTick = std::max(node.expiryTick, m_currentTick);
+        const auto delta = std::min(expiryTick - m_currentTick, (uint64_t{ 1 } << (SlotBits*LevelCount)) - 1);
+
+        size_t level = 0;
+        while (level + 1 != LevelCount && delta >= (uint64_t{ 1 } << (SlotBits*(level + 1))))
+            ++level;
+
+        const auto slotIndex = static_cast<size_t>(((m_currentTick + delta) >> (SlotBits*level)) & SlotMask);
+        const auto slot = static_cast<uint32_t>(level*SlotCount + slotIndex);
+
+        node.slot = slot;
+        node.prev = NoNode;
+        node.next = m_slots[slot];
+        if (node.next != NoNode)
+            m_nodes[node.next].prev = index;
+        m_slots[slot] = index;
+        m_occupiedSlots[level] |= uint64_t{ 1 } << slotIndex;
+    }
+
+    void UnlinkLocked(uint32_t index)
+    {
+        auto& node = m_nodes[index];
+        if (node.prev != NoNode)
+            m_nodes[node.prev].next = node.next;
+        else
+            m_slots[node.slot] = node.next;
+        if (node.next != NoNode)
+            m_nodes[node.next].prev = node.prev;
+
+        if (m_slots[node.slot] == NoNode)
+            m_occupiedSlots[node.slot/SlotCount] &= ~(uint64_t{ 1 } << (node.slot % SlotCount));
+    }
+
+    // Detaches all nodes of the slot, returns the first one (nodes stay linked by next).
+    uint32_t TakeSlotLocked(size_t level, size_t slotIndex)
+    {
+        m_occupiedSlots[level] &= ~(uint64_t{ 1 } << slotIndex);
+        return std::exchange(m_slots[level*SlotCount + slotIndex], NoNode);
+    }
+
+    // Moves timers of the current slot of the level to lower levels (upper levels first, they may refill this slot).
+    void CascadeLocked(size_t level)
+    {
+        const auto slotIndex = static_cast<size_t>((m_currentTick >> (SlotBits*level)) & SlotMask);
+        if (slotIndex == 0 && level + 1 != LevelCount)
+            CascadeLocked(level + 1);
+
+        for (auto index = TakeSlotLocked(level, slotIndex); index != NoNode;)
+            InsertLocked(std::exchange(index, m_nodes[index].next));
+    }
+
+    void ExpireSlotLocked(std::vector<detail::Callback>& expired)
+    {
+        for (auto index = TakeSlotLocked(0, static_cast<size_t>(m_currentTick & SlotMask)); index != NoNode;)
+        {
+            auto& node = m_nodes[index];
+            const auto next = node.next;
+
+            if (node.periodTicks == 0)
+            {
+                expired.push_back(std::move(node.task));
+                FreeNodeLocked(index);
+                --m_count;
+            }
+            else
+            {
+                // Fixed rate, periods missed by a late wheel are skipped.
+                if (!node.periodicTask->isRunning.exchange(true, std::memory_order_acquire))
+                {
+                    expired.push_back(detail::MakeCallback([task = node.periodicTask] {
+                        task->task();
+                        task->isRunning.store(false, std::memory_order_release);
+                    }));
+                }
+                node.expiryTick = std::max(node.expiryTick + node.periodTicks, m_currentTick + 1);
+                InsertLocked(index);
+            }
+
+            index = next;
+        }
+    }
+
+    static unsigned FindFirstSlot(uint64_t slots)
+    {
+#ifdef _MSC_VER
+        // _BitScanForward64 is not available for x86.
+        unsigned long index = 0;
+        if (_BitScanForward(&index, static_cast<unsigned long>(slots)))
+            return index;
+        _BitScanForward(&index, static_cast<unsigned long>(slots >> 32));
+        return index + 32;
+#else
+        return static_cast<unsigned>(__builtin_ctzll(slots));
+#endif
+    }
+
+    // Next tick which has something to do: the next non-empty slot of level 0 or the end of its rotation.
+    uint64_t GetNextTickLocked() const
+    {
+        const auto slotIndex = m_currentTick & SlotMask;
+        const auto rotationEnd = (m_currentTick | SlotMask) + 1;
+        if (slotIndex == SlotMask)
+            return rotationEnd;
+
+        const auto laterSlots = m_occupiedSlots[0] & (~uint64_t{ 0 } << (slotIndex + 1));
+        return laterSlots != 0 ? (m_currentTick & ~SlotMask) + FindFirstSlot(laterSlots) : rotationEnd;
+    }
+
+    void AdvanceLocked(uint64_t targetTick, std::vector<detail::Callback>& expired)
+    {
+        while (m_currentTick < targetTick)
+        {
+            if (m_count == 0)
+            {
+                m_currentTick = targetTick;
+                return;
+            }
+
+            m_currentTick = std::min(GetNextTickLocked(), targetTick);
+            if ((m_currentTick & SlotMask) == 0)
+                CascadeLocked(1);
+            ExpireSlotLocked(expired);
+        }
+    }
+
+    void Run()
+    {
+        std::vector<detail::Callback> expired;
+
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        while (!m_isStopped)
+        {
+            AdvanceLocked(GetCurrentTick(), expired);
+
+            if (!expired.empty())
+            {
+                // Tasks are posted without the lock, so they may schedule timers.
+                lock.unlock();
+                for (auto& task : expired)
+                    m_executor.Post(std::move(task));
+                expired.clear();
+                lock.lock();
+                continue;
+            }
+
+            if (m_count == 0)
+            {
+                m_wakeTick = static_cast<uint64_t>(-1);
+                m_condition.wait(lock);
+            }
+            else
+            {
+                m_wakeTick = GetNextTickLocked();
+                m_condition.wait_until(lock, GetTickTime(m_wakeTick));
+            }
+        }
+    }
+
+    const Executor                   m_executor;
+    const ClockType::duration        m_resolution;
+    const ClockType::time_point      m_startTime;
+
+    mutable std::mutex               m_mutex;
+    std::condition_variable          m_condition;
+    std::vector<Node>                m_nodes;
+    std::vector<uint32_t>            m_slots; // Heads of slot lists, level by level
+    uint64_t                         m_occupiedSlots[LevelCount]{};
+    uint32_t                         m_freeNode{ NoNode };
+    size_t                           m_count{ 0 };
+    uint64_t                         m_currentTick{ 0 }; // All timers up to this tick have been expired
+    uint64_t                         m_wakeTick{ static_cast<uint64_t>(-1) };
+    bool                             m_isStopped{ false };
+    std::thread                      m_thread;
+};
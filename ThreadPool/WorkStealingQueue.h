@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/** The WorkStealingQueue<T> class implements lock-free Chase-Lev deque.
+* - Only the owner thread may call Push() and Pop(), they work LIFO at the bottom of the deque.
+* - Any thread may call Steal(), it works FIFO at the top of the deque and competes with other thieves by CAS.
+* Memory orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013).
+* Elements are read speculatively by thieves, so only trivially copyable types (e.g. pointers) are allowed.
+*/
+template <typename T>
+class WorkStealingQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingQueue supports only trivially copyable types");
+
+public:
+    explicit WorkStealingQueue(size_t capacity = 1024)
+    {
+        size_t powerOfTwo = 1;
+        while (powerOfTwo < capacity)
+            powerOfTwo <<= 1;
+
+        m_buffers.push_back(std::make_unique<Buffer>(powerOfTwo));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    void Push(T item)
+    {
+        const auto bottom = m_bottom.load(std::memory_order_relaxed);
+        const auto top = m_top.load(std::memory_order_acquire);
+        auto* buffer = m_buffer.load(std::memory_order_relaxed);
+
+        if (bottom - top > static_cast<std::int64_t>(buffer->Capacity()) - 1)
+            buffer = Grow(buffer, top, bottom);
+
+        buffer->Put(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    bool Pop(T& item)
+    {
+        const auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        auto* buffer = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Deque is empty.
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = buffer->Get(bottom);
+        if (top != bottom)
+            return true;
+
+        // The last element: race against thieves.
+        const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    bool Steal(T& item)
+    {
+        auto top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return false;
+
+        // Buffer is never freed until destruction, so speculative read is safe.
+        auto* buffer = m_buffer.load(std::memory_order_acquire);
+        item = buffer->Get(top);
+        return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool Empty() const
+    {
+        const auto top = m_top.load(std::memory_order_relaxed);
+        const auto bottom = m_bottom.load(std::memory_order_relaxed);
+        return top >= bottom;
+    }
+
+    size_t Size() const
+    {
+        const auto top = m_top.load(std::memory_order_relaxed);
+        const auto bottom = m_bottom.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+private:
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+    class Buffer
+    {
+    public:
+        explicit Buffer(size_t capacity)
+            : m_mask{ capacity - 1 }
+            , m_items{ std::make_unique<std::atomic<T>[]>(capacity) }
+        {}
+
+        size_t Capacity() const { return m_mask + 1; }
+
+        void Put(std::int64_t index, T item)
+        {
+            m_items[static_cast<size_t>(index) & m_mask].store(item, std::memory_order_relaxed);
+        }
+
+        T Get(std::int64_t index) const
+        {
+            return m_items[static_cast<size_t>(index) & m_mask].load(std::memory_order_relaxed);
+        }
+
+    private:
+        size_t m_mask;
+        std::unique_ptr<std::atomic<T>[]> m_items;
+    };
+
+    Buffer* Grow(Buffer* buffer, std::int64_t top, std::int64_t bottom)
+    {
+        // Thieves may still read from the old buffer, so it is retired (kept alive) rather than freed.
+        auto grown = std::make_unique<Buffer>(buffer->Capacity() * 2);
+        for (auto index = top; index != bottom; ++index)
+            grown->Put(index, buffer->Get(index));
+
+        m_buffers.push_back(std::move(grown));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_release);
+        return m_buffers.back().get();
+    }
+
+    alignas(64) std::atomic<std::int64_t> m_top{ 0 };
+    alignas(64) std::atomic<std::int64_t> m_bottom{ 0 };
+    alignas(64) std::atomic<Buffer*>      m_buffer{ nullptr };
+    std::vector<std::unique_ptr<Buffer>>  m_buffers; // Owned by the owner thread only
+};
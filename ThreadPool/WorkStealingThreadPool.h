@@ -1,6 +1,13 @@
 #pragma once
 
+#include "Cancellation.h"
+#include "Coroutine.h"
 #include "TaskQueue.h"
+#include "ThreadPoolOptions.h"
+#include "ThreadPoolStats.h"
+#include "TimerWheel.h"
+#include "WorkStealingQueue.h"
+#include "WorkerSupervisor.h"
 #include <algorithm>
 #include <thread>
 
@@ -9,69 +16,504 @@ class WorkStealingThreadPool
 public:
 
     explicit WorkStealingThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()));
+    explicit WorkStealingThreadPool(const ThreadPoolOptions& options);
     ~WorkStealingThreadPool();
 
     template<typename TaskT>
     auto ExecuteAsync(TaskT&& task)
     {
-        const auto index = m_queueIndex++;
-        for (size_t n = 0; n != m_queues.size()*m_tryoutCount; ++n)
+        return ExecuteAsync(TaskPriority::Normal, std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    auto ExecuteAsync(TaskPriority priority, TaskT&& task)
+    {
+        auto job = MakePackagedTask(std::forward<TaskT>(task));
+        auto future = job.get_future(Executor{ *this });
+        Post(priority, std::move(job));
+        detail::RejectIfNotPosted(job);
+        return future;
+    }
+
+    // Prioritized tasks always go to injection queues (deques have no priorities), where every worker finds
+    // high priority work before anything else.
+    template<typename TaskT>
+    bool Post(TaskPriority priority, TaskT&& task)
+    {
+        if (priority == TaskPriority::Normal)
+            return Post(std::forward<TaskT>(task));
+
+        for (;;)
+        {
+            auto& queue = t_currentPool == this ? m_queues[t_currentIndex] : m_queues[m_queueIndex++ % m_workers.GetActiveCount()];
+            if (queue.Post(priority, std::forward<TaskT>(task)))
+            {
+                Notify();
+                return true;
+            }
+
+            // Queue of a retired worker is closed: the task (not consumed) goes to another one.
+            if (!queue.IsClosed())
+                return false;
+        }
+    }
+
+    // Returns false if the task is rejected (see AdmissionPolicy), rejected task is not consumed.
+    // Deques of workers are unbounded: queue limits apply to tasks submitted from outside of the pool.
+    template<typename TaskT>
+    bool Post(TaskT&& task)
+    {
+        // Tasks spawned by a worker go to its own deque: no locks, and they stay hot in its cache.
+        if (t_currentPool == this)
+        {
+            m_pending.Add();
+            m_deques[t_currentIndex].Push(MakeDequeTask(std::forward<TaskT>(task)));
+            Notify();
+            return true;
+        }
+
+        for (;;)
+        {
+            const auto activeCount = m_workers.GetActiveCount();
+            const auto index = m_queueIndex++;
+            for (size_t n = 0; n != activeCount*m_tryoutCount; ++n)
+            {
+                // TryPost consumes the task only on success, so the same task can be offered to every queue.
+                if (m_queues[(index + n) % activeCount].TryPost(std::forward<TaskT>(task)))
+                {
+                    Notify();
+                    return true;
+                }
+            }
+
+            auto& queue = m_queues[index % activeCount];
+            if (queue.Post(std::forward<TaskT>(task)))
+            {
+                Notify();
+                return true;
+            }
+
+            // Queue of a retired worker is closed: the task (not consumed) goes to another one.
+            if (!queue.IsClosed())
+                return false;
+        }
+    }
+
+    template<typename IteratorT>
+    auto ExecuteBatch(IteratorT first, IteratorT last)
+    {
+        auto [jobs, futures] = PackageTasks(first, last, Executor{ *this });
+        PostBatch(std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+        for (auto& job : jobs)
+            detail::RejectIfNotPosted(job);
+        return std::move(futures);
+    }
+
+    // Returns number of posted tasks (rejected ones are left in the range).
+    template<typename IteratorT>
+    size_t PostBatch(IteratorT first, IteratorT last)
+    {
+        const auto taskCount = static_cast<size_t>(std::distance(first, last));
+
+        if (t_currentPool == this)
         {
-            // Here we need not to std::forward just copy task.
-            // Because if the universal reference of task has bound to an r-value reference 
-            // then std::forward will have the same effect as std::move and thus task is not required to contain a valid task. 
-            // Universal reference must only be std::forward'ed a exactly zero or one times.
-            auto result = m_queues[(index + n) % m_queues.size()].TryPush(task); 
-
-            if (result)
-                return std::move(*result);
+            m_pending.Add(taskCount);
+            for (; first != last; ++first)
+                m_deques[t_currentIndex].Push(MakeDequeTask(*first));
+            Notify(taskCount);
+            return taskCount;
         }
-        return m_queues[index % m_queues.size()].Push(std::forward<TaskT>(task));
+
+        // Batch is split into contiguous chunks (one per queue of active workers), so every queue is locked only once.
+        const auto activeCount = m_workers.GetActiveCount();
+        const auto queueCount = std::min(taskCount, activeCount);
+        const auto index = m_queueIndex.fetch_add(queueCount);
+
+        size_t postedCount = 0;
+        for (size_t n = 0; n != queueCount; ++n)
+        {
+            const auto chunkSize = taskCount*(n + 1)/queueCount - taskCount*n/queueCount;
+            const auto chunkLast = std::next(first, chunkSize);
+            auto& queue = m_queues[(index + n) % activeCount];
+
+            auto chunkFirst = first;
+            const auto chunkPostedCount = queue.PostBatch(chunkFirst, chunkLast);
+            postedCount += chunkPostedCount;
+
+            // Worker of the queue has just retired: the rest of the chunk is posted task by task.
+            if (chunkPostedCount != chunkSize && queue.IsClosed())
+            {
+                for (std::advance(chunkFirst, chunkPostedCount); chunkFirst != chunkLast && Post(*chunkFirst); ++chunkFirst)
+                    ++postedCount;
+            }
+
+            first = chunkLast;
+        }
+
+        if (postedCount != 0)
+            Notify(postedCount);
+        return postedCount;
+    }
+
+    // Task is not run if the token is cancelled before a worker takes it: its future gets TaskCancelledError.
+    template<typename TaskT>
+    auto ExecuteAsync(const CancellationToken& token, TaskT&& task)
+    {
+        return ExecuteAsync(detail::MakeCancellableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // As ExecuteAsync with token, cancelled task is dropped. Unlike Post(task), rejected task is consumed.
+    template<typename TaskT>
+    bool Post(const CancellationToken& token, TaskT&& task)
+    {
+        return Post(detail::MakeSkippableTask(token, std::forward<TaskT>(task)));
+    }
+
+    // Task is posted to the pool after the delay (see TimerWheel), the returned id cancels it.
+    template<typename TaskT>
+    TimerId ScheduleAfter(std::chrono::steady_clock::duration delay, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + delay, {}, std::forward<TaskT>(task));
+    }
+
+    template<typename TaskT>
+    TimerId ScheduleAt(std::chrono::steady_clock::time_point time, TaskT&& task)
+    {
+        return m_timers.Schedule(time, {}, std::forward<TaskT>(task));
+    }
+
+    // Task is posted every period, the first time after one period.
+    template<typename TaskT>
+    TimerId SchedulePeriodic(std::chrono::steady_clock::duration period, TaskT&& task)
+    {
+        return m_timers.Schedule(std::chrono::steady_clock::now() + period, period, std::forward<TaskT>(task));
+    }
+
+    // Returns false if the timer has already fired or been cancelled.
+    bool CancelTimer(TimerId id)
+    {
+        return m_timers.Cancel(id);
+    }
+
+#ifdef THREAD_POOL_COROUTINES
+    // co_await pool.Schedule() resumes the coroutine on a worker of the pool (see Coroutine.h).
+    ScheduleAwaiter Schedule()
+    {
+        return ScheduleAwaiter{ Executor{ *this } };
+    }
+#endif
+
+    // Current number of workers (it changes with load in elastic pool).
+    size_t GetThreadCount() const
+    {
+        return m_workers.GetActiveCount();
+    }
+
+    // Waits until all posted tasks are done (including tasks posted by them). Must not be called from a task of the pool.
+    void WaitIdle()
+    {
+        m_pending.Wait(m_waitPolicy);
     }
 
+    // Snapshot of runtime statistics (only pool level counts if THREAD_POOL_STATS is 0).
+    ThreadPoolStats GetStats() const;
+
+    // Stops workers and cancels timers which have not fired, tasks posted after that are rejected. Destructor uses ShutdownMode::Discard.
+    void Shutdown(ShutdownMode mode = ShutdownMode::Drain);
+
 private:
 
+    // Thieves read deque elements speculatively, so deques hold pointers to nodes with tasks.
+    // Nodes are recycled (see RecyclingAllocator), so spawning a task does not allocate in steady state.
+    struct DequeNode
+    {
+        TaskQueue::TaskType task;
+    };
+
+    // Deque tasks are stamped with submission time for queue latency statistics (as tasks of queues).
+    template<typename TaskT>
+    static DequeNode* MakeDequeTask(TaskT&& task)
+    {
+        auto queueTask = TaskQueue::MakeTask(std::forward<TaskT>(task));
+        return new (detail::RecyclingAllocator<DequeNode>::Allocate()) DequeNode{ std::move(queueTask) };
+    }
+
+    static TaskQueue::TaskType TakeDequeTask(DequeNode* node)
+    {
+        auto task = std::move(node->task);
+        node->~DequeNode();
+        detail::RecyclingAllocator<DequeNode>::Deallocate(node);
+        return task;
+    }
+
     void Run(size_t queueIndex);
+    bool TryGetTask(size_t queueIndex, TaskQueue::TaskType& task, bool& retry);
+    void Notify(size_t taskCount = 1);
+    bool Wait(size_t epoch);
+    bool Park(size_t epoch);
 
+    // Queued (in queues and deques) and running tasks.
+    detail::TaskCounter m_pending;
+    // Tasks submitted from outside of the pool (injection queues).
     std::vector<TaskQueue> m_queues;
+    // Tasks spawned by workers: owner works at the bottom, thieves steal from the top.
+    std::vector<WorkStealingQueue<DequeNode*>> m_deques;
     std::atomic<size_t>    m_queueIndex{ 0 };
     const size_t m_tryoutCount{ 1 };
+    WaitPolicy   m_waitPolicy;
+
+    // Victims of every worker: workers of the same NUMA node first.
+    detail::WorkerPlacement m_placement;
+    std::vector<std::vector<size_t>> m_victims;
+    std::vector<detail::WorkerCounters> m_stats;
+
+    // Parking of idle workers (event count): every submission bumps epoch,
+    // worker parks only if epoch has not changed since it started looking for a task.
+    std::atomic<bool>       m_enabled{ true };
+    std::atomic<size_t>     m_epoch{ 0 };
+    std::atomic<size_t>     m_parkedCount{ 0 };
+    std::mutex              m_parkMutex;
+    std::condition_variable m_parkCondition;
 
-    std::vector<std::thread> m_threads;
+    detail::WorkerSupervisor m_workers;
+    TimerWheel m_timers;
+
+    static thread_local WorkStealingThreadPool* t_currentPool;
+    static thread_local size_t                  t_currentIndex;
 };
 
+thread_local WorkStealingThreadPool* WorkStealingThreadPool::t_currentPool{ nullptr };
+thread_local size_t                  WorkStealingThreadPool::t_currentIndex{ 0 };
+
 WorkStealingThreadPool::WorkStealingThreadPool(size_t threadCount)
-    : m_queues{ threadCount }
+    : WorkStealingThreadPool(ThreadPoolOptions{ threadCount })
+{}
+
+WorkStealingThreadPool::WorkStealingThreadPool(const ThreadPoolOptions& options)
+    : m_queues{ options.threadCount }
+    , m_deques(options.threadCount)
+    , m_waitPolicy{ options.waitPolicy }
+    , m_placement{ options.threadCount, options.affinity }
+    , m_stats(options.threadCount)
+    , m_workers{ options }
+    , m_timers{ Executor{ *this }, options.timerResolution }
 {
-    for (size_t index = 0; index != threadCount; ++index)
-        m_threads.emplace_back([this, index] { Run(index); });
+    for (size_t index = 0; index != options.threadCount; ++index)
+        m_victims.push_back(m_placement.GetVictims(index));
+
+    for (auto& queue : m_queues)
+    {
+        queue.SetAgingLimit(options.priorityAgingLimit);
+        queue.SetLimits(options.queueLimits);
+        queue.SetTaskCounter(&m_pending);
+        queue.SetOwner(this);
+    }
+
+    m_workers.Start([this](size_t index) { Run(index); }, m_pending, [this](size_t index) { m_queues[index].Open(); });
 }
 
 WorkStealingThreadPool::~WorkStealingThreadPool()
 {
-   const bool finishTasks = false;
-    
+    Shutdown(ShutdownMode::Discard);
+}
+
+void WorkStealingThreadPool::Shutdown(ShutdownMode mode)
+{
+    m_timers.Stop();
+
+    if (mode == ShutdownMode::Drain)
+        WaitIdle();
+
+    m_workers.Stop();
+
+    const bool finishTasks = false;
+
     for (auto& queue : m_queues)
         queue.SetEnabled(finishTasks);
 
-    for (auto& thread : m_threads)
-        thread.join();
+    {
+        std::lock_guard<std::mutex> lock{ m_parkMutex };
+        m_enabled = false;
+    }
+    m_parkCondition.notify_all();
+
+    m_workers.Join();
+
+    // Unfinished tasks are dropped (their futures get broken promise).
+    for (auto& deque : m_deques)
+    {
+        DequeNode* node = nullptr;
+        while (deque.Pop(node))
+        {
+            TakeDequeTask(node);
+            m_pending.Done();
+        }
+    }
+
+    for (auto& queue : m_queues)
+        queue.Clear();
+}
+
+ThreadPoolStats WorkStealingThreadPool::GetStats() const
+{
+    auto stats = detail::CollectStats(m_stats);
+    stats.threadCount = m_workers.GetActiveCount();
+    stats.pendingCount = m_pending.GetCount();
+    for (size_t index = 0; index != m_queues.size(); ++index)
+    {
+        stats.workers[index].queueSize = m_queues[index].GetSize() + m_deques[index].Size();
+        stats.queuedCount += stats.workers[index].queueSize;
+    }
+    return stats;
 }
 
 void WorkStealingThreadPool::Run(size_t queueIndex)
 {
-    while (m_queues[queueIndex].IsEnabled())
+    t_currentPool = this;
+    t_currentIndex = queueIndex;
+    m_placement.Apply(queueIndex);
+
+    auto& stats = m_stats[queueIndex];
+    stats.MakeCurrent();
+
+    while (m_enabled)
     {
-        TaskQueue::TaskPtrType task;
-        for (size_t n = 0; n != m_queues.size()*m_tryoutCount; ++n)
+        const auto epoch = m_epoch.load();
+
+        TaskQueue::TaskType task;
+        bool retry = false;
+        if (TryGetTask(queueIndex, task, retry))
         {
-            if (m_queues[(queueIndex + n) % m_queues.size()].TryPop(task))
-                break;
+            const auto startTime = stats.StartTask();
+            task();
+            stats.FinishTask(startTime);
+            m_pending.Done();
         }
-
-        if (!task && !m_queues[queueIndex].WaitAndPop(task))
+        else if (retry)
+            std::this_thread::yield();
+        else if (!Wait(epoch) && m_workers.TryRetire(queueIndex))
+        {
+            // Own deque is empty (only the owner pushes to it). Closed injection queue rejects new tasks
+            // (they are posted to other queues), tasks posted before are executed.
+            auto& queue = m_queues[queueIndex];
+            queue.Close();
+            while (m_enabled && queue.GetSize() != 0)
+            {
+                if (queue.TryPop(task))
+                {
+                    const auto startTime = stats.StartTask();
+                    task();
+                    stats.FinishTask(startTime);
+                    m_pending.Done();
+                }
+            }
             return;
+        }
+    }
+}
+
+bool WorkStealingThreadPool::TryGetTask(size_t queueIndex, TaskQueue::TaskType& task, bool& retry)
+{
+    DequeNode* stolen = nullptr;
+    auto& stats = m_stats[queueIndex];
+
+    // High priority work first, wherever it is queued.
+    if (m_queues[queueIndex].HasTasks(TaskPriority::High) && m_queues[queueIndex].TryPop(task))
+        return true;
+
+    for (const auto victim : m_victims[queueIndex])
+    {
+        if (m_queues[victim].HasTasks(TaskPriority::High) && m_queues[victim].TryPop(task))
+        {
+            stats.AddSteal(true);
+            detail::Trace(TaskTrace::EventType::Steal, victim);
+            return true;
+        }
+    }
+
+    // Then own work: LIFO from own deque, then FIFO from own injection queue.
+    if (m_deques[queueIndex].Pop(stolen))
+    {
+        task = TakeDequeTask(stolen);
+        return true;
+    }
+
+    if (m_queues[queueIndex].TryPop(task))
+        return true;
+
+    for (size_t n = 0; n != m_victims[queueIndex].size()*m_tryoutCount; ++n)
+    {
+        const auto victim = m_victims[queueIndex][n % m_victims[queueIndex].size()];
+
+        if (m_deques[victim].Steal(stolen))
+        {
+            task = TakeDequeTask(stolen);
+            stats.AddSteal(true);
+            detail::Trace(TaskTrace::EventType::Steal, victim);
+            return true;
+        }
+
+        // Lost the race to another thief (or owner), but there is still something to take.
+        retry = retry || !m_deques[victim].Empty();
+
+        const auto isStolen = m_queues[victim].TryPop(task);
+        stats.AddSteal(isStolen);
+        if (isStolen)
+        {
+            detail::Trace(TaskTrace::EventType::Steal, victim);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingThreadPool::Notify(size_t taskCount)
+{
+    m_epoch.fetch_add(1);
+
+    const auto parkedCount = m_parkedCount.load();
+    if (parkedCount != 0)
+    {
+        // Taking the lock guarantees that worker is either already waiting or will see new epoch.
+        { std::lock_guard<std::mutex> lock{ m_parkMutex }; }
+
+        if (taskCount >= parkedCount)
+            m_parkCondition.notify_all();
+        else
+            while (taskCount-- != 0)
+                m_parkCondition.notify_one();
+    }
+}
 
-        (*task)();
+bool WorkStealingThreadPool::Wait(size_t epoch)
+{
+    // Spinning while nothing is submitted (epoch is the same), then parking.
+    SpinWait spinWait{ m_waitPolicy };
+    while (m_epoch.load() == epoch)
+    {
+        if (!spinWait.SpinOnce())
+            return Park(epoch);
     }
+    return true;
+}
+
+// Returns false if nothing is submitted for idle timeout of the pool.
+bool WorkStealingThreadPool::Park(size_t epoch)
+{
+    std::unique_lock<std::mutex> lock{ m_parkMutex };
+
+    const auto isWoken = [this, epoch] { return !m_enabled || m_epoch.load() != epoch; };
+    const auto parkStartTime = isWoken() ? detail::StatsClock::time_point{} : detail::WorkerCounters::StartPark();
+
+    ++m_parkedCount;
+    auto result = true;
+    if (m_workers.IsElastic())
+        result = m_parkCondition.wait_for(lock, m_workers.GetIdleTimeout(), isWoken);
+    else
+        m_parkCondition.wait(lock, isWoken);
+    --m_parkedCount;
+
+    detail::WorkerCounters::FinishPark(parkStartTime);
+    return result;
 }
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "TaskGroup.h"
+#include "ThreadPoolOptions.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace detail
+{
+    /** The WorkerSupervisor class owns worker threads of a pool. Every worker has a fixed slot (index in [0, threadCount)),
+    * so per-worker structures of a pool are allocated once and never resized.
+    * Fixed pool runs all workers until shutdown. Elastic pool (minThreadCount < threadCount) keeps workers [0, active):
+    * - supervisor thread checks backlog (pending tasks not taken by workers) every scaleInterval
+    *   and starts one more worker if backlog is seen on two consecutive checks (e.g. workers are blocked on I/O);
+    * - worker of the highest active slot retires after idleTimeout without tasks (if there are more than minThreadCount).
+    * Slot of retired worker is reused only after its thread exits (it may still run tasks left in its queue),
+    * supervisor never waits for that.
+    */
+    class WorkerSupervisor
+    {
+    public:
+        using RunType = std::function<void(size_t worker)>;
+        using StartType = std::function<void(size_t worker)>;
+
+        explicit WorkerSupervisor(const ThreadPoolOptions& options)
+            : m_minCount{ options.minThreadCount == 0 ? options.threadCount : std::clamp<size_t>(options.minThreadCount, 1, options.threadCount) }
+            , m_idleTimeout{ options.idleTimeout }
+            , m_scaleInterval{ options.scaleInterval }
+            , m_threads(options.threadCount)
+            , m_isRunning(options.threadCount, false)
+        {}
+
+        ~WorkerSupervisor()
+        {
+            Stop();
+            Join();
+        }
+
+        // onStart is called before worker of the slot is (re)started.
+        void Start(RunType run, const TaskCounter& pending, StartType onStart = {})
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_run = std::move(run);
+            m_pending = &pending;
+            m_onStart = std::move(onStart);
+
+            while (m_activeCount < m_minCount)
+                StartWorkerLocked();
+
+            if (IsElastic())
+                m_supervisor = std::thread{ [this] { Supervise(); } };
+        }
+
+        // Stops starting of new workers (workers themselves are stopped by the pool).
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                m_isStopped = true;
+            }
+            m_condition.notify_all();
+
+            if (m_supervisor.joinable())
+                m_supervisor.join();
+        }
+
+        void Join()
+        {
+            for (auto& thread : m_threads)
+            {
+                if (thread.joinable())
+                    thread.join();
+            }
+        }
+
+        bool IsElastic() const
+        {
+            return m_minCount < m_threads.size();
+        }
+
+        // How long idle worker waits for a task before trying to retire (infinite for fixed pool).
+        std::chrono::steady_clock::duration GetIdleTimeout() const
+        {
+            return IsElastic() ? m_idleTimeout : std::chrono::steady_clock::duration::max();
+        }
+
+        size_t GetActiveCount() const
+        {
+            return m_activeCount.load(std::memory_order_acquire);
+        }
+
+        size_t GetMaxCount() const
+        {
+            return m_threads.size();
+        }
+
+        // Is called by idle worker: only the worker of the highest active slot may retire, then it must exit.
+        bool TryRetire(size_t worker)
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            const auto activeCount = m_activeCount.load(std::memory_order_relaxed);
+            if (m_isStopped || activeCount != worker + 1 || activeCount <= m_minCount)
+                return false;
+
+            m_activeCount.store(worker, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        WorkerSupervisor(const WorkerSupervisor&) = delete;
+        WorkerSupervisor& operator=(const WorkerSupervisor&) = delete;
+
+        // Returns false if retired worker of the slot has not exited yet.
+        bool StartWorkerLocked()
+        {
+            const auto worker = m_activeCount.load(std::memory_order_relaxed);
+            if (m_isRunning[worker])
+                return false;
+
+            // Thread of the slot has exited already, so join does not block.
+            if (m_threads[worker].joinable())
+                m_threads[worker].join();
+
+            if (m_onStart)
+                m_onStart(worker);
+
+            m_isRunning[worker] = true;
+            m_threads[worker] = std::thread{ [this, worker] {
+                m_run(worker);
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                m_isRunning[worker] = false;
+            } };
+            m_activeCount.store(worker + 1, std::memory_order_release);
+            return true;
+        }
+
+        void Supervise()
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            size_t lastBacklog = 0;
+            while (!m_condition.wait_for(lock, m_scaleInterval, [this] { return m_isStopped; }))
+            {
+                const auto pendingCount = m_pending->GetCount();
+                const auto activeCount = m_activeCount.load(std::memory_order_relaxed);
+                const auto backlog = pendingCount > activeCount ? pendingCount - activeCount : 0;
+
+                // If the slot is still busy, backlog is kept and the next check tries again.
+                if (backlog != 0 && lastBacklog != 0 && activeCount < m_threads.size() && !StartWorkerLocked())
+                    continue;
+
+                lastBacklog = backlog;
+            }
+        }
+
+        using DurationType = std::chrono::steady_clock::duration;
+
+        const size_t       m_minCount;
+        const DurationType m_idleTimeout;
+        const DurationType m_scaleInterval;
+
+        RunType            m_run;
+        const TaskCounter* m_pending{ nullptr };
+        StartType          m_onStart;
+
+        std::atomic<size_t>      m_activeCount{ 0 };
+        bool                     m_isStopped{ false };
+        std::mutex               m_mutex;
+        std::condition_variable  m_condition;
+        std::thread              m_supervisor;
+        std::vector<std::thread> m_threads;
+        std::vector<bool>        m_isRunning; // Thread of the slot has not exited yet (guarded by the mutex)
+    };
+
+} // namespace detail